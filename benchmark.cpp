@@ -11,12 +11,21 @@
 #include <array>
 #include <memory>
 #include <regex>
+#include "src/book_analytics.hpp"
+#include "src/admission.hpp"
+#include "src/order_template.hpp"
+#include <atomic>
+#include <deque>
+#include <mutex>
 
 # define PRICE 10000
 # define AMOUNT 10
 # define NEW_PRICE 2000
 # define NEW_AMOUNT 20
 
+// Every run shares one encrypted token cache, so samples skip the public/auth round trip
+const std::string CLIENT_CMD = "./TradingClient --token-cache .deribit_token";
+
 int getRandomInRange(int min, int max) {
     return min + rand() % (max - min + 1);
 }
@@ -126,8 +135,8 @@ int extractOrderLatencyFromOutput(const std::string& output) {
 
 
 // Place an order and log the latency to a CSV file.
-void putOrderAndLogLatency(std::ofstream& outputFile) {
-    // Input arguments: outputFile (std::ofstream&) - Output file stream to write the data.
+void putOrderAndLogLatency(std::ofstream& outputFile, const std::string& clientArgs = "") {
+    // Input arguments: outputFile (std::ofstream&) - Output file stream to write the data, clientArgs (const std::string&) - Extra TradingClient flags.
 
     std::string instrument = getRandomText();
     int price = PRICE;
@@ -137,7 +146,7 @@ void putOrderAndLogLatency(std::ofstream& outputFile) {
     cmd << "(echo 1 && echo " << instrument 
         << " && echo " << price 
         << " && echo " << amount 
-        << " && echo 9) | ./TradingClient";
+        << " && echo 9) | " << CLIENT_CMD << clientArgs;
 
     try {
         std::string output = executeCommand(cmd.str());
@@ -152,8 +161,8 @@ void putOrderAndLogLatency(std::ofstream& outputFile) {
 }
 
 // Calculate order latency and stores the orders and latency in a CSV file.
-void Calculate_Order_Latency(int n = 100, int delay = 100,std::string filename = "order_placed_latency.csv") {
-    // Input arguments: n (int) - Number of iterations, delay (int) - Delay between measurements in milliseconds, filename (std::string) - Name of the output file.
+void Calculate_Order_Latency(int n = 100, int delay = 100,std::string filename = "order_placed_latency.csv", std::string clientArgs = "") {
+    // Input arguments: n (int) - Number of iterations, delay (int) - Delay between measurements in milliseconds, filename (std::string) - Name of the output file, clientArgs (std::string) - Extra TradingClient flags.
 
     std::ofstream orderFile(filename);
     
@@ -167,7 +176,7 @@ void Calculate_Order_Latency(int n = 100, int delay = 100,std::string filename =
     const int NUM_ITERATIONS = n;
     
     for (int i = 0; i < NUM_ITERATIONS; ++i) {
-        putOrderAndLogLatency(orderFile);
+        putOrderAndLogLatency(orderFile, clientArgs);
         
         std::this_thread::sleep_for(std::chrono::milliseconds(delay)); // Delay to wait and gaurantee the order is placed
     }
@@ -206,7 +215,7 @@ void fetchAndSaveOrderIDs(std::ofstream& outputFile) {
     // Input arguments: outputFile (std::ofstream&) - Output file stream to write the data.
 
     std::stringstream cmd;
-    cmd << "(echo 2 && sleep 1 && echo 9) | ./TradingClient";
+    cmd << "(echo 2 && sleep 1 && echo 9) | " << CLIENT_CMD;
 
     try {
         std::string output = executeCommand(cmd.str());
@@ -306,7 +315,7 @@ void modifyOrderAndLogLatency(const std::string& orderID, std::ofstream& outputF
     cmd << "(echo 3 && echo " << orderID 
         << " && echo " << newPrice 
         << " && echo " << newAmount 
-        << " && echo 9) | ./TradingClient";
+        << " && echo 9) | " << CLIENT_CMD;
 
     try {
         std::string output = executeCommand(cmd.str());
@@ -368,53 +377,61 @@ void Calculate_Modification_Latency(int delay = 100,std::string filename = "orde
     std::cout << "Average Modification Latency: " << LatencyAverage << "ms" << std::endl;
 }
 
-// Extract cancellation latency from output
-int extractCancellationLatencyFromOutput(const std::string& output) {
+// Extract per-order cancellation latencies from the bulk cancel output
+std::vector<std::pair<std::string, double>> extractCancellationLatenciesFromOutput(const std::string& output) {
+    // Input arguments: output (const std::string&) - Output from TradingClient.
+    // Output: (std::vector<std::pair<std::string, double>>) - Order ID and cancellation latency in milliseconds,
+    //         from lines "Cancelled Order: <id> (<state>) in <latency> ms".
+
+    std::cout << "Raw cancellation output: " << output << std::endl;
+    std::vector<std::pair<std::string, double>> latencies;
+    const std::string prefix = "Cancelled Order: ";
+    std::istringstream lines(output);
+    std::string line;
+    while (std::getline(lines, line)) {
+        size_t pos = line.find(prefix);
+        if (pos == std::string::npos) continue;
+        size_t idStart = pos + prefix.size();
+        size_t idEnd = line.find(' ', idStart);
+        size_t startPos = line.find(") in ", idStart);
+        if (idEnd == std::string::npos || startPos == std::string::npos) continue;
+        startPos += 5;  // Length of ") in "
+        size_t endPos = line.find(" ms", startPos);
+        if (endPos == std::string::npos) continue;
+        try {
+            latencies.emplace_back(line.substr(idStart, idEnd - idStart), std::stod(line.substr(startPos, endPos - startPos)));
+        } catch (const std::exception& e) {
+            std::cerr << "Error converting cancellation latency string: " << e.what() << std::endl;
+        }
+    }
+    return latencies;
+}
+
+// Extract the wall time of the whole bulk cancel from output
+double extractBulkCancelLatencyFromOutput(const std::string& output) {
     // Input arguments: output (const std::string&) - Output from TradingClient.
-    // Output: (int) - Cancellation latency in milliseconds.
+    // Output: (double) - Bulk cancellation latency in milliseconds, -1 if not found.
 
-    std::cout << "Raw cancellation output: " << output << std::endl; 
-    size_t pos = output.find("Order Cancelled Latency : ");
+    size_t pos = output.find("Bulk Cancel Latency : ");
     if (pos != std::string::npos) {
-        size_t startPos = pos + 25;  // Length of "Order Cancelled Latency : "
+        size_t startPos = pos + 22;  // Length of "Bulk Cancel Latency : "
         size_t endPos = output.find(" ms", startPos);
         if (endPos != std::string::npos) {
-            std::string latencyStr = output.substr(startPos, endPos - startPos);
             try {
-                return std::stoi(latencyStr);
+                return std::stod(output.substr(startPos, endPos - startPos));
             } catch (const std::exception& e) {
-                std::cerr << "Error converting cancellation latency string: " << e.what() << std::endl;
-                return -1;
+                std::cerr << "Error converting bulk cancellation latency string: " << e.what() << std::endl;
             }
         }
     }
-    return -1;  // If latency is not found
-}
-
-// Function to cancel an order and log the latency
-void removeOrderAndLogLatency(const std::string& orderID, std::ofstream& outputFile) {
-    // Input arguments: orderID (const std::string&) - Order ID to cancel, outputFile (std::ofstream&) - Output file stream to write the data.
-
-    std::stringstream cmd;
-    cmd << "(echo 4 && echo " << orderID 
-        << " && echo 9) | ./TradingClient";
-
-    try {
-        std::string output = executeCommand(cmd.str());
-        int latency = extractCancellationLatencyFromOutput(output);
-        
-        outputFile << orderID << "," << latency << "\n";
-        outputFile.flush();
-        
-        std::cout << "Order " << orderID << " cancelled with latency: " << latency << "ms" << std::endl;
-    } catch (const std::exception& e) {
-        std::cerr << "Error cancelling order: " << e.what() << std::endl;
-    }
+    return -1;
 }
 
-// Process all order cancellations (Wrapper Function)
-void Calculate_Cancellation_Latency(int delay = 100,std::string filename = "order_cancel_latency.csv") {
-    // Input arguments: filename (std::string) - Name of the output file. delay (int) - Delay between cancellations in milliseconds.
+// Process all order cancellations (Wrapper Function). The orders are cancelled in one
+// bulk call (menu option 10), which runs them concurrently and sends a single
+// cancel_all_by_instrument for an instrument whose live orders are exactly those listed.
+void Calculate_Cancellation_Latency(std::string filename = "order_cancel_latency.csv") {
+    // Input arguments: filename (std::string) - Name of the output file.
 
     std::ofstream cancellationFile(filename);
     
@@ -430,21 +447,25 @@ void Calculate_Cancellation_Latency(int delay = 100,std::string filename = "orde
         return;
     }
 
+    double bulkLatency = -1;
     try {
         std::vector<std::string> orderIDs = readOrderIDs("../order_ids.txt");
         
         if (orderIDs.empty()) {
             std::cerr << "No order IDs found in order_ids.txt" << std::endl;
+            chdir("..");
             return;
         }
 
         std::cout << "Found " << orderIDs.size() << " orders to cancel" << std::endl;
 
-        for (const auto& orderID : orderIDs) {
-            removeOrderAndLogLatency(orderID, cancellationFile);
-
-            std::this_thread::sleep_for(std::chrono::milliseconds(delay)); // Small delay between cancellations
+        std::string output = executeCommand("(echo 10 && echo ../order_ids.txt && echo 9) | " + CLIENT_CMD);
+        auto latencies = extractCancellationLatenciesFromOutput(output);
+        for (const auto& latency : latencies) {
+            cancellationFile << latency.first << "," << latency.second << "\n";
         }
+        bulkLatency = extractBulkCancelLatencyFromOutput(output);
+        std::cout << "Cancelled " << latencies.size() << " of " << orderIDs.size() << " orders" << std::endl;
 
     } catch (const std::exception& e) {
         std::cerr << "Error during order cancellations: " << e.what() << std::endl;
@@ -455,6 +476,7 @@ void Calculate_Cancellation_Latency(int delay = 100,std::string filename = "orde
 
     double LatencyAverage = calculateLatencyAverage(filename,1);
     std::cout << "Average Cancellation Latency: " << LatencyAverage << "ms" << std::endl;
+    std::cout << "Total Bulk Cancellation Latency: " << bulkLatency << "ms" << std::endl;
 }
 
 // Extract orderbook latency from output
@@ -490,7 +512,7 @@ void getOrderbookAndLogLatency(std::ofstream& outputFile) {
     std::stringstream cmd;
     cmd << "(echo 5 && echo " << instrument 
         << " && echo " << depth 
-        << " && echo 9) | ./TradingClient";
+        << " && echo 9) | " << CLIENT_CMD;
 
     try {
         std::string output = executeCommand(cmd.str());
@@ -575,7 +597,7 @@ void subscribeMarketDataAndLogLatency(std::ofstream& outputFile,int suscribed_fo
     cmd << "(echo 7 && echo " << instrument 
         << " && echo " << duration 
         << " && sleep " << (duration + 1) // Sleep for duration + 1 second to ensure we capture all data
-        << " && echo 9) | ./TradingClient";
+        << " && echo 9) | " << CLIENT_CMD;
 
     try {
         auto timestamp = std::chrono::system_clock::now();
@@ -643,6 +665,180 @@ void Calculate_Web_Socket_Latency(int numIterations=10,int delay = 100,std::stri
 }
 
 
+// Place the same orders over HTTP and over the WebSocket session and compare the latencies.
+void Compare_Order_Transports(int n = 20, int delay = 100) {
+    // Input arguments: n (int) - Orders per transport, delay (int) - Delay between orders in milliseconds.
+
+    Calculate_Order_Latency(n, delay, "order_placed_latency_http.csv");
+    Calculate_Order_Latency(n, delay, "order_placed_latency_ws.csv", " --ws-orders");
+
+    double httpAverage = calculateLatencyAverage("order_placed_latency_http.csv", 3);
+    double wsAverage = calculateLatencyAverage("order_placed_latency_ws.csv", 3);
+    std::cout << "Order placement over " << n << " orders per transport" << std::endl;
+    std::cout << "HTTP (libcurl):        " << httpAverage << "ms" << std::endl;
+    std::cout << "WebSocket (JSON-RPC):  " << wsAverage << "ms" << std::endl;
+    if (wsAverage > 0) {
+        std::cout << "Speedup:               " << httpAverage / wsAverage << "x" << std::endl;
+    }
+}
+
+
+// Time one analytics kernel over a synthetic ladder and return nanoseconds per call.
+template<typename Kernel>
+double timeKernel(Kernel kernel, int iterations) {
+    // Input arguments: kernel (callable) - Kernel invocation returning a double, iterations (int) - Number of calls
+    // Output: (double) - Average time per call in nanoseconds
+
+    volatile double sink = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        sink = sink + kernel();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+// Compare the AVX book analytics kernels with the scalar loops on the same ladder.
+void Calculate_Analytics_Speedup(int levels = 1000, int iterations = 100000) {
+    // Input arguments: levels (int) - Depth of the synthetic ladder, iterations (int) - Calls per kernel
+
+#ifndef __AVX__
+    std::cout << "Benchmark built without AVX, compile with -mavx to compare kernels." << std::endl;
+#endif
+    std::vector<int64_t> prices(levels), volumes(levels);
+    for (int i = 0; i < levels; ++i) {
+        prices[i] = 120000 + i;                   // ticks, best level at the back
+        volumes[i] = getRandomInRange(1, 500);    // lots
+    }
+    const int64_t *p = prices.data(), *v = volumes.data();
+    const size_t n = prices.size();
+    const double target = 0.75 * BookKernels::sumLevelsScalar(p, v, n).volume;
+
+    double scalarVwap = timeKernel([&] { auto s = BookKernels::sumLevelsScalar(p, v, n); return s.notional / s.volume; }, iterations);
+    double scalarSweep = timeKernel([&] { double f = 0, c = 0; int64_t w = 0; BookKernels::sweepScalar(p, v, n, target, f, c, w); return c; }, iterations);
+    double simdVwap = timeKernel([&] { auto s = BookKernels::sumLevels(p, v, n); return s.notional / s.volume; }, iterations);
+    double simdSweep = timeKernel([&] { double f = 0, c = 0; int64_t w = 0; BookKernels::sweep(p, v, n, target, f, c, w); return c; }, iterations);
+
+    std::cout << "Book analytics over " << levels << " levels (" << iterations << " iterations)" << std::endl;
+    std::cout << "VWAP/imbalance  scalar: " << scalarVwap << "ns, SIMD: " << simdVwap << "ns, speedup: " << scalarVwap / simdVwap << "x" << std::endl;
+    std::cout << "Sweep cost      scalar: " << scalarSweep << "ns, SIMD: " << simdSweep << "ns, speedup: " << scalarSweep / simdSweep << "x" << std::endl;
+}
+
+
+// Connection handles as they were before the lock-free pool: a mutex-guarded vector
+struct MutexAdmission {
+    std::vector<int*> handles;
+    std::mutex poolMutex;
+
+    explicit MutexAdmission(std::vector<int>& slots) {
+        for (int& slot : slots) handles.push_back(&slot);
+    }
+
+    int* acquire() {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (handles.empty()) return nullptr;
+        int* h = handles.back();
+        handles.pop_back();
+        return h;
+    }
+
+    void release(int* h) {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        handles.push_back(h);
+    }
+};
+
+// Same path on FreeList (src/admission.hpp)
+struct LockFreeAdmission {
+    FreeList<int> handles;
+
+    explicit LockFreeAdmission(std::vector<int>& slots) : handles(slots.size()) {
+        for (int& slot : slots) handles.tryPush(&slot);
+    }
+
+    int* acquire() { return handles.tryPop(); }
+    void release(int* h) { handles.tryPush(h); }
+};
+
+// Admissions per second with `threads` threads each doing `ops` handle
+// acquire/release pairs, as every HTTP/1.1 transfer does
+template<typename Admission>
+double measureAdmission(Admission& admission, int threads, int ops) {
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            while (!go.load()) std::this_thread::yield();
+            for (int i = 0; i < ops; ++i) {
+                int* h = admission.acquire();
+                if (h) {
+                    ++*h;
+                    admission.release(h);
+                }
+            }
+        });
+    }
+    auto start = std::chrono::steady_clock::now();
+    go.store(true);
+    for (auto& w : workers) w.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return threads * static_cast<double>(ops) / seconds;
+}
+
+// Compare request-admission throughput of the mutex and lock-free designs as threads are added.
+void Calculate_Admission_Contention(int ops = 200000) {
+    // Input arguments: ops (int) - Admissions per thread
+    // Output: (void) - Prints admissions per second for each thread count
+
+    std::vector<int> slots(10);
+    int maxThreads = std::max(2u, std::thread::hardware_concurrency());
+    std::cout << "Threads  Mutex (Mops/s)  Lock-free (Mops/s)  Speedup" << std::endl;
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        MutexAdmission mutexAdmission(slots);
+        LockFreeAdmission lockFreeAdmission(slots);
+        double mutexRate = measureAdmission(mutexAdmission, threads, ops);
+        double lockFreeRate = measureAdmission(lockFreeAdmission, threads, ops);
+        std::cout << threads << "        " << mutexRate / 1e6 << "        " << lockFreeRate / 1e6
+                  << "        " << lockFreeRate / mutexRate << "x" << std::endl;
+    }
+}
+
+// Compare serializing a private/buy with nlohmann::json against the order template (src/order_template.hpp).
+void Calculate_Serialization_Speed(int n = 1000000) {
+    // Input arguments: n (int) - Orders serialized per method
+    // Output: (void) - Prints nanoseconds per order for each method
+
+    InstrumentSpec spec("BTC-PERPETUAL", 0.5, 10, 10);
+    std::string out;
+    size_t bytes = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) {
+        json payload = {
+            {"jsonrpc", "2.0"},
+            {"id", i},
+            {"method", "private/buy"},
+            {"params", {{"instrument_name", spec.name}, {"type", "limit"}, {"price", 63000.5 + i % 100}, {"amount", 300.0}}}};
+        out = payload.dump();
+        bytes += out.size();
+    }
+    double jsonNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+
+    OrderRequest order = OrderRequest::buy(spec, spec.toPrice(63000.5), spec.toQuantity(300));
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) {
+        order.price.ticks = 126001 + 2 * (i % 100);
+        order.write(out, i);
+        bytes += out.size();
+    }
+    double templateNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+
+    std::cout << "nlohmann::json: " << jsonNs << " ns/order" << std::endl;
+    std::cout << "Order template: " << templateNs << " ns/order" << std::endl;
+    std::cout << "Speedup: " << jsonNs / templateNs << "x (" << bytes << " bytes)" << std::endl;
+}
+
+
 void displayMenu() {
     std::cout << "\nTrading System Latency Benchmark Tool\n";
     std::cout << "====================================\n";
@@ -653,7 +849,11 @@ void displayMenu() {
     std::cout << "5. Measure Web Socket Latency\n";
     std::cout << "6. Fetch Order IDs\n";
     std::cout << "7. Run All Benchmarks\n";
-    std::cout << "8. Exit\n";
+    std::cout << "8. Measure Book Analytics Speedup (AVX vs scalar)\n";
+    std::cout << "9. Compare Order Transports (HTTP vs WebSocket)\n";
+    std::cout << "10. Measure Request Admission Contention (mutex vs lock-free)\n";
+    std::cout << "11. Measure Order Serialization (json vs template)\n";
+    std::cout << "12. Exit\n";
     std::cout << "Choice: ";
 }
 
@@ -731,6 +931,26 @@ int main() {
 
             break;
         case 8:
+            std::cout << "Enter number of book levels: ";
+            std::cin >> n;
+            Calculate_Analytics_Speedup(n);
+            break;
+        case 9:
+            std::cout << "Enter number of orders per transport: ";
+            std::cin >> n;
+            Compare_Order_Transports(n);
+            break;
+        case 10:
+            std::cout << "Enter number of admissions per thread: ";
+            std::cin >> n;
+            Calculate_Admission_Contention(n);
+            break;
+        case 11:
+            std::cout << "Enter number of orders: ";
+            std::cin >> n;
+            Calculate_Serialization_Speed(n);
+            break;
+        case 12:
             return 0;
         default:
             std::cout << "Invalid choice\n";
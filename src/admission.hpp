@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Lock-free pool of pointers with a fixed number of slots.
+// Two Treiber stacks of slot indices: `full` holds slots carrying an item,
+// `vacant` the others. Taking an item moves its slot from full to vacant,
+// giving one back moves a slot the other way; with every slot full the item
+// is refused. Heads pack a generation tag with the index so a slot that is
+// popped and pushed again between a load and a CAS (ABA) is detected.
+template<typename T>
+class FreeList {
+    static constexpr uint32_t NIL = 0xffffffffu;
+
+    struct Slot {
+        T* item = nullptr;                // owned by whoever holds the slot
+        std::atomic<uint32_t> next{NIL};
+    };
+
+    const size_t capacity;
+    std::unique_ptr<Slot[]> slots;
+    alignas(64) std::atomic<uint64_t> full{NIL};
+    alignas(64) std::atomic<uint64_t> vacant{NIL};
+
+    static uint32_t indexOf(uint64_t head) { return static_cast<uint32_t>(head); }
+    static uint64_t tagged(uint64_t head, uint32_t index) { return ((head >> 32) + 1) << 32 | index; }
+
+    uint32_t pop(std::atomic<uint64_t>& head) {
+        uint64_t h = head.load(std::memory_order_acquire);
+        while (indexOf(h) != NIL) {
+            uint32_t next = slots[indexOf(h)].next.load(std::memory_order_relaxed);
+            if (head.compare_exchange_weak(h, tagged(h, next), std::memory_order_acquire, std::memory_order_acquire)) {
+                return indexOf(h);
+            }
+        }
+        return NIL;
+    }
+
+    void push(std::atomic<uint64_t>& head, uint32_t index) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        do {
+            slots[index].next.store(indexOf(h), std::memory_order_relaxed);
+        } while (!head.compare_exchange_weak(h, tagged(h, index), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+public:
+    explicit FreeList(size_t slotCount) : capacity(slotCount), slots(new Slot[slotCount]) {
+        for (size_t i = 0; i < slotCount; ++i) {
+            push(vacant, static_cast<uint32_t>(i));
+        }
+    }
+
+    size_t size() const { return capacity; }
+
+    // nullptr when no item is available
+    T* tryPop() {
+        uint32_t index = pop(full);
+        if (index == NIL) return nullptr;
+        T* item = slots[index].item;
+        push(vacant, index);
+        return item;
+    }
+
+    // false when every slot already holds an item; the caller keeps it
+    bool tryPush(T* item) {
+        uint32_t index = pop(vacant);
+        if (index == NIL) return false;
+        slots[index].item = item;
+        push(full, index);
+        return true;
+    }
+};
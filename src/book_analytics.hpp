@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <immintrin.h>
+#include "order_book.hpp"
+
+// Order book analytics computed straight off the ladder arrays.
+// The kernels work on the integer tick/lot arrays exposed by LevelView and
+// only scale to real prices/amounts at the end. With AVX enabled (-mavx)
+// four levels are processed per instruction; otherwise the scalar loops are
+// used. The AVX kernels add in four lanes and combine them at the end, so
+// their sums can differ from the scalar loops in the last bits; both agree
+// up to rounding.
+
+// Sum of volumes and of price * volume over a run of levels, in ticks and lots
+struct LevelSums {
+    double notional = 0;  // sum(ticks * lots)
+    double volume = 0;    // sum(lots)
+};
+
+// Result of sweeping one side of the book for a given amount
+struct SweepResult {
+    double filled = 0;        // amount that could be filled
+    double cost = 0;          // sum(price * amount) over the levels consumed
+    double averagePrice = 0;  // cost / filled
+    double worstPrice = 0;    // last level touched
+};
+
+// Raw kernels over (prices, volumes) arrays of n levels
+class BookKernels {
+public:
+    static LevelSums sumLevelsScalar(const int64_t* prices, const int64_t* volumes, size_t n) {
+        LevelSums s;
+        for (size_t i = 0; i < n; ++i) {
+            s.notional += static_cast<double>(prices[i]) * static_cast<double>(volumes[i]);
+            s.volume += static_cast<double>(volumes[i]);
+        }
+        return s;
+    }
+
+    // Walks levels from the back (best) towards the front until `target` lots are filled
+    static void sweepScalar(const int64_t* prices, const int64_t* volumes, size_t n, double target,
+                            double& filled, double& notional, int64_t& lastPrice) {
+        for (size_t i = n; i-- > 0 && filled < target;) {
+            double take = static_cast<double>(volumes[i]);
+            if (filled + take > target) take = target - filled;
+            filled += take;
+            notional += static_cast<double>(prices[i]) * take;
+            lastPrice = prices[i];
+        }
+    }
+
+#ifdef __AVX__
+    // Non-negative int64 (< 2^52) to double without AVX2/AVX-512: OR the integer
+    // into the mantissa of 2^52 and subtract 2^52.
+    static __m256d toDouble(const int64_t* p) {
+        const __m256d magic = _mm256_set1_pd(4503599627370496.0);
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        return _mm256_sub_pd(_mm256_or_pd(_mm256_castsi256_pd(v), magic), magic);
+    }
+
+    static double horizontalSum(__m256d v) {
+        __m128d lo = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+        return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+    }
+
+    static LevelSums sumLevelsAvx(const int64_t* prices, const int64_t* volumes, size_t n) {
+        __m256d notional = _mm256_setzero_pd();
+        __m256d volume = _mm256_setzero_pd();
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256d p = toDouble(prices + i);
+            __m256d v = toDouble(volumes + i);
+            notional = _mm256_add_pd(notional, _mm256_mul_pd(p, v));
+            volume = _mm256_add_pd(volume, v);
+        }
+        LevelSums s = sumLevelsScalar(prices + i, volumes + i, n - i);
+        s.notional += horizontalSum(notional);
+        s.volume += horizontalSum(volume);
+        return s;
+    }
+
+    // Consumes whole blocks of four levels while they fit in the remaining amount,
+    // the block that crosses the target is finished by the scalar loop
+    static void sweepAvx(const int64_t* prices, const int64_t* volumes, size_t n, double target,
+                         double& filled, double& notional, int64_t& lastPrice) {
+        size_t end = n;
+        while (end >= 4) {
+            __m256d v = toDouble(volumes + end - 4);
+            double blockVolume = horizontalSum(v);
+            if (filled + blockVolume > target) break;
+            notional += horizontalSum(_mm256_mul_pd(toDouble(prices + end - 4), v));
+            filled += blockVolume;
+            lastPrice = prices[end - 4];
+            end -= 4;
+            if (filled >= target) return;
+        }
+        sweepScalar(prices, volumes, end, target, filled, notional, lastPrice);
+    }
+#endif
+
+    static LevelSums sumLevels(const int64_t* prices, const int64_t* volumes, size_t n) {
+#ifdef __AVX__
+        return sumLevelsAvx(prices, volumes, n);
+#else
+        return sumLevelsScalar(prices, volumes, n);
+#endif
+    }
+
+    static void sweep(const int64_t* prices, const int64_t* volumes, size_t n, double target,
+                      double& filled, double& notional, int64_t& lastPrice) {
+#ifdef __AVX__
+        sweepAvx(prices, volumes, n, target, filled, notional, lastPrice);
+#else
+        sweepScalar(prices, volumes, n, target, filled, notional, lastPrice);
+#endif
+    }
+};
+
+class BookAnalytics {
+public:
+    // Volume weighted average price of the best `levels` levels of one side, 0 when empty
+    static double vwap(const LevelView& side, size_t levels, const InstrumentSpec& spec) {
+        LevelView top = side.top(levels);
+        LevelSums s = BookKernels::sumLevels(top.prices, top.volumes, top.size);
+        if (s.volume <= 0) return 0;
+        return s.notional / s.volume * spec.tick_size;
+    }
+
+    // Top-of-book price weighted by the opposite side's size, 0 when a side is empty
+    static double microprice(const OrderBook& book) {
+        const auto& bids = book.getBids();
+        const auto& asks = book.getAsks();
+        if (bids.empty() || asks.empty()) return 0;
+        double bidPrice = static_cast<double>(bids.bestPrice().ticks);
+        double askPrice = static_cast<double>(asks.bestPrice().ticks);
+        double bidVolume = static_cast<double>(bids.bestVolume().lots);
+        double askVolume = static_cast<double>(asks.bestVolume().lots);
+        return (bidPrice * askVolume + askPrice * bidVolume) / (bidVolume + askVolume) * book.getSpec().tick_size;
+    }
+
+    // (bid volume - ask volume) / (bid volume + ask volume) over the best `levels` levels, in [-1, 1]
+    static double imbalance(const OrderBook& book, size_t levels) {
+        LevelView bids = book.bidLevels().top(levels);
+        LevelView asks = book.askLevels().top(levels);
+        double bidVolume = BookKernels::sumLevels(bids.prices, bids.volumes, bids.size).volume;
+        double askVolume = BookKernels::sumLevels(asks.prices, asks.volumes, asks.size).volume;
+        double total = bidVolume + askVolume;
+        return total > 0 ? (bidVolume - askVolume) / total : 0;
+    }
+
+    // Cost of taking `amount` from one side (asks for a buy, bids for a sell)
+    static SweepResult sweepCost(const LevelView& side, double amount, const InstrumentSpec& spec) {
+        SweepResult r;
+        double filled = 0, notional = 0;
+        int64_t lastPrice = 0;
+        double target = static_cast<double>(spec.toQuantity(amount).lots);
+        BookKernels::sweep(side.prices, side.volumes, side.size, target, filled, notional, lastPrice);
+        if (filled <= 0) return r;
+        double lotSize = spec.lot.toDouble(1);
+        r.filled = filled * lotSize;
+        r.cost = notional * spec.tick_size * lotSize;
+        r.averagePrice = notional / filled * spec.tick_size;
+        r.worstPrice = spec.tick.toDouble(lastPrice);
+        return r;
+    }
+};
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include "order_book.hpp"
+#include "feed_parser.hpp"
+
+// Callback interface for book updates.
+// onBookUpdate() runs on the shard thread that owns the book, right after the
+// update was applied and published, so implementations must be cheap and must
+// not block: record what changed and do the real work elsewhere. The book
+// reference stays valid for the lifetime of the TradingManager; from other
+// threads only its getSpec() and topOfBook() are safe to call.
+// Trades and ticker notifications are delivered on the instrument's shard too,
+// observers that only care about books can ignore them.
+class BookObserver {
+public:
+    virtual ~BookObserver() = default;
+    virtual void onBookUpdate(const std::string& instrument, const OrderBook& book, OrderBook::SyncResult result) = 0;
+    virtual void onTrades(const std::string&, const std::vector<TradeRecord>&) {}
+    virtual void onTicker(const std::string&, const TickerRecord&) {}
+};
+
+// Copy-on-write list of observers, notify() takes no lock and costs a single
+// atomic load when nothing is registered.
+class BookObserverList {
+private:
+    using List = std::vector<std::shared_ptr<BookObserver>>;
+    std::shared_ptr<const List> observers = std::make_shared<const List>();
+    std::atomic<size_t> count{0};
+    std::mutex writeMutex;
+
+public:
+    void add(const std::shared_ptr<BookObserver>& observer) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        auto next = std::make_shared<List>(*std::atomic_load(&observers));
+        next->push_back(observer);
+        count.store(next->size(), std::memory_order_release);
+        std::atomic_store(&observers, std::shared_ptr<const List>(std::move(next)));
+    }
+
+    void remove(const std::shared_ptr<BookObserver>& observer) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        auto next = std::make_shared<List>(*std::atomic_load(&observers));
+        next->erase(std::remove(next->begin(), next->end(), observer), next->end());
+        count.store(next->size(), std::memory_order_release);
+        std::atomic_store(&observers, std::shared_ptr<const List>(std::move(next)));
+    }
+
+    void notify(const std::string& instrument, const OrderBook& book, OrderBook::SyncResult result) const {
+        if (count.load(std::memory_order_acquire) == 0) return;
+        auto current = std::atomic_load(&observers);
+        for (const auto& observer : *current) {
+            observer->onBookUpdate(instrument, book, result);
+        }
+    }
+
+    void notifyTrades(const std::string& instrument, const std::vector<TradeRecord>& trades) const {
+        if (count.load(std::memory_order_acquire) == 0) return;
+        auto current = std::atomic_load(&observers);
+        for (const auto& observer : *current) {
+            observer->onTrades(instrument, trades);
+        }
+    }
+
+    void notifyTicker(const std::string& instrument, const TickerRecord& ticker) const {
+        if (count.load(std::memory_order_acquire) == 0) return;
+        auto current = std::atomic_load(&observers);
+        for (const auto& observer : *current) {
+            observer->onTicker(instrument, ticker);
+        }
+    }
+
+    bool empty() const { return count.load(std::memory_order_acquire) == 0; }
+};
+
+// Console view of the subscribed books, redrawn at a fixed rate from its own
+// thread. The feed only flags the instrument as dirty; the renderer reads the
+// seqlock-published top of book, so a slow terminal never stalls the feed.
+class ConsoleBookRenderer : public BookObserver {
+private:
+    struct Entry {
+        const OrderBook* book = nullptr;
+        std::atomic<bool> dirty{false};
+    };
+
+    std::unordered_map<std::string, std::unique_ptr<Entry>> entries;
+    std::mutex entriesMutex;
+    std::chrono::milliseconds interval;
+    size_t levels;
+    bool stop = false;
+    std::mutex stopMutex;
+    std::condition_variable stopCondition;
+    std::thread renderThread;
+
+    // The lock is otherwise only taken by the render thread, once per redraw
+    Entry* entryFor(const std::string& instrument, const OrderBook& book) {
+        std::lock_guard<std::mutex> lock(entriesMutex);
+        auto& entry = entries[instrument];
+        if (!entry) {
+            entry = std::make_unique<Entry>();
+            entry->book = &book;
+        }
+        return entry.get();
+    }
+
+    void render(const std::string& instrument, const OrderBook& book) {
+        const InstrumentSpec& spec = book.getSpec();
+        TopOfBook top = book.topOfBook();
+        std::cout << "Current Order Book State: " << instrument << " (change_id " << top.changeId
+                  << (top.resyncing ? ", resyncing" : "") << ")\n";
+        std::cout << "Top Bids:\n";
+        for (size_t i = 0; i < top.bidCount && i < levels; ++i) {
+            std::cout << "Price: " << spec.tick.toDouble(top.bidPrices[i]) << ", Volume: " << spec.lot.toDouble(top.bidVolumes[i]) << '\n';
+        }
+        std::cout << "\nTop Asks:\n";
+        for (size_t i = 0; i < top.askCount && i < levels; ++i) {
+            std::cout << "Price: " << spec.tick.toDouble(top.askPrices[i]) << ", Volume: " << spec.lot.toDouble(top.askVolumes[i]) << '\n';
+        }
+        std::cout << std::endl;
+    }
+
+    void run() {
+        std::vector<std::pair<std::string, Entry*>> dirty;
+        std::unique_lock<std::mutex> lock(stopMutex);
+        while (!stopCondition.wait_for(lock, interval, [this] { return stop; })) {
+            dirty.clear();
+            {
+                std::lock_guard<std::mutex> entriesLock(entriesMutex);
+                for (auto& entry : entries) {
+                    if (entry.second->dirty.exchange(false, std::memory_order_acq_rel)) {
+                        dirty.emplace_back(entry.first, entry.second.get());
+                    }
+                }
+            }
+            for (auto& entry : dirty) {
+                render(entry.first, *entry.second->book);
+            }
+        }
+    }
+
+public:
+    explicit ConsoleBookRenderer(std::chrono::milliseconds redrawInterval = std::chrono::milliseconds(500), size_t depth = 5)
+        : interval(redrawInterval), levels(depth < TopOfBook::DEPTH ? depth : TopOfBook::DEPTH),
+          renderThread([this] { run(); }) {}
+
+    ~ConsoleBookRenderer() override {
+        {
+            std::lock_guard<std::mutex> lock(stopMutex);
+            stop = true;
+        }
+        stopCondition.notify_all();
+        renderThread.join();
+    }
+
+    void onBookUpdate(const std::string& instrument, const OrderBook& book, OrderBook::SyncResult) override {
+        entryFor(instrument, book)->dirty.store(true, std::memory_order_release);
+    }
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+// Fixed-size view of the best levels of a book, cheap to copy as a whole
+struct TopOfBook {
+    static constexpr size_t DEPTH = 10;
+
+    int64_t changeId = -1;
+    int64_t timestamp = 0;       // exchange timestamp of the last applied update (ms)
+    uint32_t bidCount = 0;       // valid entries in the bid arrays, best first
+    uint32_t askCount = 0;       // valid entries in the ask arrays, best first
+    uint32_t resyncing = 0;      // book is waiting for a snapshot, levels may be stale
+    uint32_t padding = 0;
+    std::array<int64_t, DEPTH> bidPrices{};   // ticks
+    std::array<int64_t, DEPTH> bidVolumes{};  // lots
+    std::array<int64_t, DEPTH> askPrices{};   // ticks
+    std::array<int64_t, DEPTH> askVolumes{};  // lots
+};
+
+// Single-writer / multi-reader seqlock.
+// The writer bumps the sequence to an odd value, stores the payload and bumps
+// it again; readers copy the payload and retry if the sequence was odd or
+// moved meanwhile. Readers never block the writer and never take a lock.
+// The payload is stored as relaxed atomic words so concurrent reads and
+// writes are well defined.
+template<typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock payload must be trivially copyable");
+    static constexpr size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    alignas(64) std::atomic<uint64_t> sequence{0};
+    std::array<std::atomic<uint64_t>, WORDS> words{};
+
+public:
+    Seqlock() {
+        T empty{};
+        store(empty);
+    }
+
+    // Writer side, must only be called from one thread at a time
+    void store(const T& value) {
+        uint64_t buffer[WORDS] = {};
+        std::memcpy(buffer, &value, sizeof(T));
+
+        uint64_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; ++i) {
+            words[i].store(buffer[i], std::memory_order_relaxed);
+        }
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    // Single attempt, false when the copy raced with a store
+    bool tryLoad(T& out) const {
+        uint64_t before = sequence.load(std::memory_order_acquire);
+        if (before & 1) return false;
+        uint64_t buffer[WORDS];
+        for (size_t i = 0; i < WORDS; ++i) {
+            buffer[i] = words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) != before) return false;
+        std::memcpy(&out, buffer, sizeof(T));
+        return true;
+    }
+
+    // Consistent copy, spins while a store is in progress
+    T load() const {
+        T out;
+        for (int spins = 0; !tryLoad(out); ++spins) {
+            if (spins > 64) std::this_thread::yield();
+        }
+        return out;
+    }
+
+    // Number of completed stores
+    uint64_t version() const { return sequence.load(std::memory_order_acquire) / 2; }
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// Runs `count` asynchronous jobs with at most `limit` of them in flight.
+// start(index, done) begins job `index` and must arrange for done() to be
+// called exactly once, from any thread, when it has finished; the next job
+// is started from there. wait() blocks until every job is done.
+class BoundedBatch {
+public:
+    using Done = std::function<void()>;
+    using Start = std::function<void(size_t index, Done done)>;
+
+private:
+    struct State {
+        std::mutex mutex;
+        std::condition_variable finishedAll;
+        size_t count;
+        size_t next = 0;
+        size_t finished = 0;
+        Start start;
+    };
+
+    std::shared_ptr<State> state;
+
+    // Jobs whose done() runs synchronously start the next one in a loop, not by recursion
+    static void run(const std::shared_ptr<State>& s, size_t index) {
+        while (true) {
+            auto ranInline = std::make_shared<bool>(false);
+            auto inStart = std::make_shared<bool>(true);
+            auto handOff = std::make_shared<size_t>(s->count);
+            s->start(index, [s, ranInline, inStart, handOff]() {
+                size_t following = s->count;
+                {
+                    std::lock_guard<std::mutex> lock(s->mutex);
+                    ++s->finished;
+                    if (s->next < s->count) following = s->next++;
+                    if (*inStart) {
+                        *ranInline = true;
+                        *handOff = following;
+                    }
+                }
+                if (!*ranInline && following < s->count) run(s, following);
+                s->finishedAll.notify_all();
+            });
+            size_t following;
+            {
+                std::lock_guard<std::mutex> lock(s->mutex);
+                *inStart = false;
+                if (!*ranInline) return;
+                following = *handOff;
+            }
+            if (following >= s->count) return;
+            index = following;
+        }
+    }
+
+public:
+    BoundedBatch(size_t count, size_t limit, Start start) : state(std::make_shared<State>()) {
+        state->count = count;
+        state->start = std::move(start);
+        size_t first;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            first = limit == 0 ? count : (limit < count ? limit : count);
+            state->next = first;
+        }
+        for (size_t i = 0; i < first; ++i) run(state, i);
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finishedAll.wait(lock, [this] { return state->finished == state->count; });
+    }
+};
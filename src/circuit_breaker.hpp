@@ -0,0 +1,236 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Trip rules of one breaker
+struct BreakerConfig {
+    std::chrono::seconds window{10};                 // sliding window of outcomes
+    uint32_t minRequests = 10;                       // no verdict on fewer calls
+    double maxErrorRate = 0.5;                       // trips at this failure share
+    std::chrono::milliseconds maxP99{2000};          // or at this p99 latency
+    std::chrono::milliseconds openFor{5000};         // before a probe is let through
+};
+
+// Snapshot of a breaker for monitoring
+struct BreakerMetrics {
+    const char* state;
+    uint32_t requests;      // in the window
+    uint32_t failures;
+    double errorRate;
+    double p99Ms;
+    uint64_t trips;         // closed/half-open -> open transitions
+    uint64_t rejected;      // calls refused while open
+};
+
+// Circuit breaker for one endpoint.
+// Closed: every call goes through and its outcome and latency land in a
+// sliding window; when the window holds enough calls and either the error
+// rate or the p99 latency is over its limit, the breaker opens. Open: calls
+// fail fast until `openFor` has passed, then exactly one probe is let
+// through (half-open). The probe's outcome closes the breaker with a fresh
+// window, or opens it again. Every transition starts a new generation and
+// allowRequest() hands out the current one as a ticket; outcomes of calls
+// admitted under an earlier generation are ignored, so a late reply cannot
+// decide the probe. The state is a single atomic, so the allow check on the
+// request path takes no lock; outcomes are recorded under a small
+// per-breaker mutex.
+class CircuitBreaker {
+public:
+    enum class State : uint8_t { Closed, Open, HalfOpen };
+    using Clock = std::chrono::steady_clock;
+
+private:
+    static constexpr size_t SECONDS = 60;       // ring of per-second counters, >= window
+    static constexpr size_t LATENCIES = 256;    // recent latency samples
+
+    struct Second {
+        int64_t at = -1;
+        uint32_t requests = 0;
+        uint32_t failures = 0;
+    };
+
+    struct Sample {
+        int64_t atMs = 0;
+        uint32_t micros = 0;
+    };
+
+    const BreakerConfig config;
+    std::atomic<State> state{State::Closed};
+    std::atomic<int64_t> reopenAtMs{0};   // open: earliest probe; half-open: probe deadline
+    std::atomic<uint64_t> generation{1};  // bumped on every transition
+    std::atomic<uint64_t> trips{0};
+    std::atomic<uint64_t> rejected{0};
+
+    std::mutex mutex;
+    std::array<Second, SECONDS> seconds;
+    std::array<Sample, LATENCIES> latencies;
+    size_t latencyCount = 0;
+
+    static int64_t nowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    void clearWindow() {
+        seconds.fill(Second());
+        latencyCount = 0;
+    }
+
+    void open(int64_t now) {
+        reopenAtMs.store(now + config.openFor.count());
+        ++generation;
+        state.store(State::Open);
+        ++trips;
+    }
+
+    int64_t spanSeconds() const { return std::min<int64_t>(config.window.count(), SECONDS); }
+
+    static size_t p99Rank(size_t samples) { return (samples * 99 + 99) / 100 - 1; }
+
+    // Requests and failures over the window; caller holds the mutex
+    void windowCounts(int64_t now, uint32_t& requests, uint32_t& failures) const {
+        const int64_t second = now / 1000;
+        requests = failures = 0;
+        for (const Second& s : seconds) {
+            if (s.at > second - spanSeconds()) {
+                requests += s.requests;
+                failures += s.failures;
+            }
+        }
+    }
+
+    // Whether the window's p99 latency is at least `micros`, without sorting: it is
+    // when the samples at or above it reach past the p99 rank. Caller holds the mutex.
+    bool p99AtLeast(int64_t now, uint32_t micros) const {
+        const int64_t since = now - spanSeconds() * 1000;
+        size_t samples = 0, over = 0;
+        for (size_t i = 0; i < std::min(latencyCount, LATENCIES); ++i) {
+            if (latencies[i].atMs <= since) continue;
+            ++samples;
+            if (latencies[i].micros >= micros) ++over;
+        }
+        return samples != 0 && over >= samples - p99Rank(samples);
+    }
+
+    // p99 latency (ms) over the window, for metrics(); caller holds the mutex
+    double p99Ms(int64_t now) const {
+        const int64_t since = now - spanSeconds() * 1000;
+        std::array<uint32_t, LATENCIES> recent;
+        size_t samples = 0;
+        for (size_t i = 0; i < std::min(latencyCount, LATENCIES); ++i) {
+            if (latencies[i].atMs > since) recent[samples++] = latencies[i].micros;
+        }
+        if (samples == 0) return 0;
+        const size_t rank = p99Rank(samples);
+        std::nth_element(recent.begin(), recent.begin() + rank, recent.begin() + samples);
+        return recent[rank] / 1000.0;
+    }
+
+public:
+    explicit CircuitBreaker(BreakerConfig cfg = BreakerConfig()) : config(cfg) {}
+
+    State current() const { return state.load(); }
+
+    // False while open; after `openFor` the first caller becomes the probe.
+    // `ticket` is passed back to record() with the call's outcome.
+    bool allowRequest(uint64_t& ticket) {
+        ticket = generation.load();
+        State s = state.load(std::memory_order_acquire);
+        if (s == State::Closed) return true;
+
+        int64_t now = nowMs();
+        int64_t due = reopenAtMs.load();
+        if (now >= due) {
+            // Open -> half-open, or a half-open probe that never reported back
+            if (reopenAtMs.compare_exchange_strong(due, now + config.openFor.count())) {
+                std::lock_guard<std::mutex> lock(mutex);
+                ticket = ++generation;
+                state.store(State::HalfOpen);
+                return true;
+            }
+        }
+        ++rejected;
+        return false;
+    }
+
+    void record(uint64_t ticket, bool ok, std::chrono::microseconds latency) {
+        const int64_t now = nowMs();
+        const bool slow = latency >= config.maxP99;
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // Admitted before the last transition: neither the probe nor part of this window
+        if (ticket != generation.load()) return;
+        if (state.load() == State::HalfOpen) {
+            if (ok && !slow) {
+                clearWindow();
+                ++generation;
+                state.store(State::Closed);
+            } else {
+                open(now);
+            }
+            return;
+        }
+        if (state.load() != State::Closed) return;
+
+        Second& s = seconds[static_cast<size_t>(now / 1000) % SECONDS];
+        if (s.at != now / 1000) s = Second{now / 1000, 0, 0};
+        ++s.requests;
+        if (!ok) ++s.failures;
+        latencies[latencyCount++ % LATENCIES] = Sample{now, static_cast<uint32_t>(std::min<int64_t>(latency.count(), UINT32_MAX))};
+
+        uint32_t requests, failures;
+        windowCounts(now, requests, failures);
+        if (requests < config.minRequests) return;
+        const auto maxMicros = std::chrono::duration_cast<std::chrono::microseconds>(config.maxP99).count();
+        if (failures >= config.maxErrorRate * requests || p99AtLeast(now, static_cast<uint32_t>(std::min<int64_t>(maxMicros, UINT32_MAX)))) {
+            open(now);
+        }
+    }
+
+    BreakerMetrics metrics() {
+        BreakerMetrics m;
+        State s = state.load();
+        m.state = s == State::Closed ? "closed" : s == State::Open ? "open" : "half-open";
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const int64_t now = nowMs();
+            windowCounts(now, m.requests, m.failures);
+            m.p99Ms = p99Ms(now);
+        }
+        m.errorRate = m.requests ? static_cast<double>(m.failures) / m.requests : 0.0;
+        m.trips = trips.load();
+        m.rejected = rejected.load();
+        return m;
+    }
+};
+
+// One breaker per method, created on first use and never removed, so the
+// references handed out stay valid
+class CircuitBreakerRegistry {
+    BreakerConfig config;
+    std::map<std::string, std::unique_ptr<CircuitBreaker>> breakers;
+    std::mutex mutex;
+
+public:
+    explicit CircuitBreakerRegistry(BreakerConfig cfg = BreakerConfig()) : config(cfg) {}
+
+    CircuitBreaker& get(const std::string& method) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& breaker = breakers[method];
+        if (!breaker) breaker = std::make_unique<CircuitBreaker>(config);
+        return *breaker;
+    }
+
+    template<typename F>
+    void forEach(F&& f) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& entry : breakers) f(entry.first, *entry.second);
+    }
+};
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// Order in which queued requests are released when credits are short
+enum class RequestPriority : uint8_t { Cancel = 0, Amend = 1, Order = 2, Other = 3 };
+
+// Local model of Deribit's credit-based rate limits.
+// Every request costs credits from one of two buckets, the matching-engine
+// bucket (order entry) or the non-matching bucket (everything else); buckets
+// refill continuously up to a cap. Requests are queued per priority and a
+// pacing thread releases them as soon as their bucket can pay, cancels
+// before amends before new orders, so a burst is spread out instead of being
+// rejected by the exchange with error 10028. The buckets run at `headroom`
+// of the configured limits to stay just below them.
+class CreditLimiter {
+public:
+    struct Limits {
+        double maxCredits;
+        double refillPerSecond;
+    };
+
+    struct Stats {
+        uint64_t sent = 0;
+        uint64_t delayed = 0;   // had to wait for credits or behind other requests
+        uint64_t rejected = 0;  // 10028 answers reported back
+        size_t queued = 0;
+    };
+
+    // Deribit defaults: non-matching 500 credits a call, 50000 cap, 10000/s;
+    // matching engine sized for 5 orders/s with bursts of 20
+    static constexpr int64_t DEFAULT_COST = 500;
+    static constexpr Limits MATCHING_DEFAULT{10000, 2500};
+    static constexpr Limits NON_MATCHING_DEFAULT{50000, 10000};
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Bucket {
+        Limits limits;
+        double credits;
+        Clock::time_point refilled;
+
+        void refill(Clock::time_point now) {
+            double seconds = std::chrono::duration<double>(now - refilled).count();
+            credits = std::min(limits.maxCredits, credits + seconds * limits.refillPerSecond);
+            refilled = now;
+        }
+
+        // Time until `cost` credits are available
+        Clock::duration waitFor(double cost) const {
+            if (credits >= cost) return Clock::duration::zero();
+            return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((cost - credits) / limits.refillPerSecond));
+        }
+    };
+
+    struct Pending {
+        std::function<void()> send;
+        std::function<void()> drop;
+        bool matching;
+        double cost;
+    };
+
+    const double headroom;
+    Bucket matchingBucket;
+    Bucket nonMatchingBucket;
+    std::unordered_map<std::string, int64_t> costs;  // per-method overrides
+    std::array<std::deque<Pending>, 4> queues;        // indexed by RequestPriority
+    Stats counters;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stop = false;
+    std::thread pacer;
+
+    static Limits scaled(Limits limits, double factor) {
+        return {limits.maxCredits * factor, limits.refillPerSecond * factor};
+    }
+
+    Bucket& bucketFor(bool matching) { return matching ? matchingBucket : nonMatchingBucket; }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this] { return stop || counters.queued > 0; });
+            if (stop) return;
+
+            Clock::time_point now = Clock::now();
+            matchingBucket.refill(now);
+            nonMatchingBucket.refill(now);
+
+            // Highest priority request whose bucket can pay now, else the earliest one that can
+            Pending* ready = nullptr;
+            std::deque<Pending>* from = nullptr;
+            Clock::duration wait = Clock::duration::max();
+            for (auto& queue : queues) {
+                if (queue.empty()) continue;
+                Pending& front = queue.front();
+                Clock::duration needed = bucketFor(front.matching).waitFor(front.cost);
+                if (needed == Clock::duration::zero()) {
+                    ready = &front;
+                    from = &queue;
+                    break;
+                }
+                wait = std::min(wait, needed);
+            }
+
+            if (!ready) {
+                wake.wait_for(lock, wait);
+                continue;
+            }
+            bucketFor(ready->matching).credits -= ready->cost;
+            std::function<void()> send = std::move(ready->send);
+            from->pop_front();
+            --counters.queued;
+            ++counters.sent;
+            lock.unlock();
+            send();
+            lock.lock();
+        }
+    }
+
+public:
+    explicit CreditLimiter(Limits matching = MATCHING_DEFAULT, Limits nonMatching = NON_MATCHING_DEFAULT, double headroom = 0.9)
+        : headroom(headroom),
+          matchingBucket{scaled(matching, headroom), matching.maxCredits * headroom, Clock::now()},
+          nonMatchingBucket{scaled(nonMatching, headroom), nonMatching.maxCredits * headroom, Clock::now()},
+          pacer([this] { run(); }) {}
+
+    // Requests still queued are not sent, their `drop` runs instead
+    ~CreditLimiter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        pacer.join();
+        for (auto& queue : queues) {
+            for (auto& pending : queue) {
+                if (pending.drop) pending.drop();
+            }
+        }
+    }
+
+    static bool isMatching(const std::string& method) {
+        return method == "private/buy" || method == "private/sell" || method == "private/edit" ||
+               method == "private/edit_by_label" || method == "private/close_position" ||
+               method == "private/mass_quote" || method.compare(0, 14, "private/cancel") == 0;
+    }
+
+    static RequestPriority priorityOf(const std::string& method) {
+        if (method.compare(0, 14, "private/cancel") == 0) return RequestPriority::Cancel;
+        if (method.compare(0, 12, "private/edit") == 0) return RequestPriority::Amend;
+        if (isMatching(method)) return RequestPriority::Order;
+        return RequestPriority::Other;
+    }
+
+    void setLimits(Limits matching, Limits nonMatching) {
+        std::lock_guard<std::mutex> lock(mutex);
+        matchingBucket.limits = scaled(matching, headroom);
+        nonMatchingBucket.limits = scaled(nonMatching, headroom);
+        matchingBucket.credits = std::min(matchingBucket.credits, matchingBucket.limits.maxCredits);
+        nonMatchingBucket.credits = std::min(nonMatchingBucket.credits, nonMatchingBucket.limits.maxCredits);
+    }
+
+    void setCost(const std::string& method, int64_t credits) {
+        std::lock_guard<std::mutex> lock(mutex);
+        costs[method] = credits;
+    }
+
+    // Any thread. `send` runs on the pacing thread once `method`'s bucket can
+    // pay for it and must only hand the request to the transport. If the
+    // limiter is shut down first, `drop` runs instead so the caller can fail it.
+    void submit(const std::string& method, std::function<void()> send, std::function<void()> drop) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (stop) {
+                lock.unlock();
+                if (drop) drop();
+                return;
+            }
+            auto override = costs.find(method);
+            Pending pending{std::move(send), std::move(drop), isMatching(method),
+                            static_cast<double>(override == costs.end() ? DEFAULT_COST : override->second)};
+            Bucket& bucket = bucketFor(pending.matching);
+            bucket.refill(Clock::now());
+            if (counters.queued > 0 || bucket.credits < pending.cost) {
+                ++counters.delayed;
+            }
+            queues[static_cast<size_t>(priorityOf(method))].push_back(std::move(pending));
+            ++counters.queued;
+        }
+        wake.notify_one();
+    }
+
+    // The exchange answered 10028: our model ran ahead of its bucket, so ours is emptied
+    void onRejected(const std::string& method) {
+        std::lock_guard<std::mutex> lock(mutex);
+        bucketFor(isMatching(method)).credits = 0;
+        bucketFor(isMatching(method)).refilled = Clock::now();
+        ++counters.rejected;
+    }
+
+    Stats stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+    }
+};
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "order_book.hpp"
+#include "feed_parser.hpp"
+
+// Bounded single-producer/single-consumer ring of preallocated slots.
+// The producer fills a slot in place and publishes it, the consumer reads it
+// and releases it. Slots are reused, so buffers inside them keep their
+// capacity and the steady state allocates nothing.
+template<typename T>
+class SpscRing {
+    static size_t roundUp(size_t n) {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    const size_t mask;
+    std::unique_ptr<T[]> slots;
+    alignas(64) std::atomic<size_t> head{0};  // next slot to consume
+    alignas(64) std::atomic<size_t> tail{0};  // next slot to produce
+    alignas(64) size_t cachedHead = 0;        // producer's last view of head
+    alignas(64) size_t cachedTail = 0;        // consumer's last view of tail
+
+public:
+    explicit SpscRing(size_t capacity) : mask(roundUp(capacity) - 1), slots(new T[mask + 1]) {}
+
+    // Producer: slot to fill, nullptr while the ring is full
+    T* claim() {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead > mask) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead > mask) return nullptr;
+        }
+        return &slots[t & mask];
+    }
+
+    void publish() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // Consumer: oldest published slot, nullptr when empty
+    T* front() {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (h == cachedTail) return nullptr;
+        }
+        return &slots[h & mask];
+    }
+
+    void pop() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+};
+
+// One feed message routed to a shard. Only the fields of its type are meaningful,
+// the others keep whatever a previous use of the slot left in them.
+struct FeedEvent {
+    enum class Type : uint8_t {
+        Book,        // apply `update` to `book`
+        Drain,       // apply what is pending in `conflation` to `book`
+        Trades,      // `trades` for `instrument`
+        Ticker,      // `ticker` for `instrument`
+        Invalidate   // feed connection dropped, `book` is stale until its next snapshot
+    };
+
+    Type type = Type::Book;
+    OrderBook* book = nullptr;
+    ConflationBuffer* conflation = nullptr;
+    std::string instrument;
+    BookUpdate update;
+    std::vector<TradeRecord> trades;
+    TickerRecord ticker;
+};
+
+// Routes feed messages to one consumer thread per shard. Each shard owns an
+// SPSC ring written only by the WebSocket thread, so an instrument's messages
+// are handled in arrival order by a single thread, without a lock or a
+// std::function per message. Work posted from other threads (resync
+// snapshots) goes through a small locked mailbox checked between events.
+class FeedDispatcher {
+public:
+    using Handler = std::function<void(FeedEvent&)>;
+    static constexpr size_t RING_CAPACITY = 1024;
+    static constexpr int SPIN_ROUNDS = 64;  // yields before an idle consumer sleeps
+
+private:
+    struct Shard {
+        SpscRing<FeedEvent> ring{RING_CAPACITY};
+        std::deque<std::function<void()>> control;
+        std::atomic<bool> hasControl{false};
+        std::atomic<bool> sleeping{false};
+        std::mutex mutex;  // guards control, stop and sleeping transitions
+        std::condition_variable wakeup;
+        bool stop = false;
+        std::thread worker;
+    };
+
+    Handler handler;
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    Shard& shardAt(size_t shard) { return *shards[shard % shards.size()]; }
+
+    // Pairs with the fence in run(): either the consumer sees the new slot or we see it asleep
+    static void wake(Shard& s) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (s.sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.wakeup.notify_one();
+        }
+    }
+
+    static void runControl(Shard& s) {
+        std::deque<std::function<void()>> tasks;
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            tasks.swap(s.control);
+            s.hasControl.store(false, std::memory_order_relaxed);
+        }
+        for (auto& task : tasks) task();
+    }
+
+    void run(Shard& s) {
+        int idle = 0;
+        while (true) {
+            // Checked before every event, so posted work is not starved by a busy ring
+            if (s.hasControl.load(std::memory_order_acquire)) {
+                runControl(s);
+                idle = 0;
+                continue;
+            }
+            if (FeedEvent* event = s.ring.front()) {
+                handler(*event);
+                s.ring.pop();
+                idle = 0;
+                continue;
+            }
+            if (++idle < SPIN_ROUNDS) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(s.mutex);
+            s.sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            s.wakeup.wait(lock, [&s] { return s.stop || !s.ring.empty() || !s.control.empty(); });
+            s.sleeping.store(false, std::memory_order_relaxed);
+            if (s.stop && s.ring.empty() && s.control.empty()) return;
+            idle = 0;
+        }
+    }
+
+public:
+    FeedDispatcher(size_t count, Handler eventHandler) : handler(std::move(eventHandler)) {
+        for (size_t i = 0; i < std::max<size_t>(count, 1); ++i) {
+            shards.push_back(std::make_unique<Shard>());
+        }
+        for (auto& shard : shards) {
+            Shard* s = shard.get();
+            s->worker = std::thread([this, s] { run(*s); });
+        }
+    }
+
+    ~FeedDispatcher() { shutdown(); }
+
+    // Runs what is already queued and joins the consumers; later posts are dropped.
+    // For owners whose other threads may still post while they are torn down.
+    void shutdown() {
+        for (auto& shard : shards) {
+            {
+                std::lock_guard<std::mutex> lock(shard->mutex);
+                shard->stop = true;
+            }
+            shard->wakeup.notify_all();
+        }
+        for (auto& shard : shards) {
+            if (shard->worker.joinable()) shard->worker.join();
+        }
+    }
+
+    size_t size() const { return shards.size(); }
+
+    // WebSocket thread only. `fill(FeedEvent&)` writes the event into the next
+    // slot of the shard; when the consumer is a full ring behind, the feed
+    // thread waits for it (conflation mode avoids that for slow consumers).
+    template<typename Fill>
+    void push(size_t shard, Fill&& fill) {
+        Shard& s = shardAt(shard);
+        FeedEvent* event;
+        while (!(event = s.ring.claim())) {
+            std::this_thread::yield();
+        }
+        fill(*event);
+        s.ring.publish();
+        wake(s);
+    }
+
+    // Any thread, for rare-path work that must run on the shard. Dropped once
+    // the dispatcher is shutting down.
+    template<typename F>
+    void post(size_t shard, F&& f) {
+        Shard& s = shardAt(shard);
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            if (s.stop) return;
+            s.control.emplace_back(std::forward<F>(f));
+            s.hasControl.store(true, std::memory_order_release);
+        }
+        s.wakeup.notify_one();
+    }
+};
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "order_book.hpp"
+#include "json_cursor.hpp"
+
+// One trade from a trades.<instrument>.<interval> notification
+struct TradeRecord {
+    int64_t timestamp = 0;
+    int64_t tradeSeq = 0;
+    Price price;
+    Quantity amount;
+    bool buy = false;  // taker side
+};
+
+// Best levels and reference prices from a ticker.<instrument>.<interval> notification.
+// Mark and index prices are not on the tick grid and stay doubles.
+struct TickerRecord {
+    int64_t timestamp = 0;
+    Price bestBidPrice;
+    Quantity bestBidAmount;
+    Price bestAskPrice;
+    Quantity bestAskAmount;
+    Price lastPrice;
+    double markPrice = 0;
+    double indexPrice = 0;
+};
+
+// Single-pass scanner for Deribit subscription notifications.
+// Walks the WebSocket payload in place and writes book.*, trades.* and
+// ticker.* data straight into typed records, converting decimal text to
+// ticks/lots without going through a DOM or a double. Anything it does not
+// recognise (RPC responses, escaped strings, other channels, instruments
+// without a known grid) returns Kind::None and is left to the JSON parser.
+class FeedParser {
+public:
+    enum class Kind { None, Book, Trades, Ticker };
+
+    // Records of the last parsed notification, reused across calls
+    BookUpdate book;
+    std::vector<TradeRecord> trades;
+    TickerRecord ticker;
+    std::string_view instrument;  // points into the payload
+
+    // `resolve(instrument, kind)` returns the instrument grid, or nullptr when
+    // the notification is not tracked
+    template<typename Resolve>
+    Kind parse(const std::string& payload, Resolve&& resolve) {
+        Cursor c{payload.data(), payload.data() + payload.size()};
+        bool subscription = false;
+        Kind kind = Kind::None;
+        bool parsed = false;
+
+        bool ok = c.object([&](std::string_view key) {
+            if (key == "method") {
+                std::string_view method;
+                if (!c.string(method)) return false;
+                subscription = method == "subscription";
+                return subscription;
+            }
+            if (key == "params") return parseParams(c, resolve, kind, parsed);
+            if (key == "id" || key == "result" || key == "error") return false;  // RPC response
+            return c.skipValue();
+        });
+        return ok && subscription && parsed ? kind : Kind::None;
+    }
+
+private:
+    using Cursor = JsonCursor;
+
+    // "book.<instrument>...", "trades.<instrument>..." or "ticker.<instrument>..."
+    bool channelKind(std::string_view channel, Kind& kind) {
+        size_t prefix;
+        if (channel.compare(0, 5, "book.") == 0) {
+            kind = Kind::Book;
+            prefix = 5;
+        } else if (channel.compare(0, 7, "trades.") == 0) {
+            kind = Kind::Trades;
+            prefix = 7;
+        } else if (channel.compare(0, 7, "ticker.") == 0) {
+            kind = Kind::Ticker;
+            prefix = 7;
+        } else {
+            return false;
+        }
+        size_t stop = channel.find('.', prefix);
+        instrument = channel.substr(prefix, stop == std::string_view::npos ? std::string_view::npos : stop - prefix);
+        return !instrument.empty();
+    }
+
+    // Deribit sends the channel before the data; when it does not, the data span
+    // is skipped once and parsed after the channel is known
+    template<typename Resolve>
+    bool parseParams(Cursor& c, Resolve& resolve, Kind& kind, bool& parsed) {
+        const InstrumentSpec* spec = nullptr;
+        const char* dataBegin = nullptr;
+        const char* dataEnd = nullptr;
+
+        return c.object([&](std::string_view key) {
+            if (key == "channel") {
+                std::string_view channel;
+                if (!c.string(channel) || !channelKind(channel, kind)) return false;
+                spec = resolve(instrument, kind);
+                if (!spec) return false;
+                if (dataBegin) {
+                    Cursor data{dataBegin, dataEnd};
+                    parsed = parseData(data, kind, *spec);
+                    return parsed;
+                }
+                return true;
+            }
+            if (key == "data") {
+                if (spec) {
+                    parsed = parseData(c, kind, *spec);
+                    return parsed;
+                }
+                c.skipSpace();
+                dataBegin = c.p;
+                if (!c.skipValue()) return false;
+                dataEnd = c.p;
+                return true;
+            }
+            return c.skipValue();
+        });
+    }
+
+    bool parseData(Cursor& c, Kind kind, const InstrumentSpec& spec) {
+        switch (kind) {
+            case Kind::Book: return parseBook(c, spec);
+            case Kind::Trades: return parseTrades(c, spec);
+            case Kind::Ticker: return parseTicker(c, spec);
+            default: return false;
+        }
+    }
+
+    // Same rules as OrderBook::parse: no type means a full snapshot
+    bool parseBook(Cursor& c, const InstrumentSpec& spec) {
+        book.clear();
+        bool typed = false;
+        bool ok = c.object([&](std::string_view key) {
+            if (key == "type") {
+                std::string_view type;
+                if (!c.string(type)) return false;
+                typed = true;
+                book.snapshot = type == "snapshot";
+                return true;
+            }
+            if (key == "change_id") return c.null() || c.integer(book.changeId);
+            if (key == "prev_change_id") return c.null() || c.integer(book.prevChangeId);
+            if (key == "timestamp") return c.null() || c.integer(book.timestamp);
+            if (key == "bids") return parseLevels(c, spec, book.bids);
+            if (key == "asks") return parseLevels(c, spec, book.asks);
+            return c.skipValue();
+        });
+        if (!typed) book.snapshot = true;
+        return ok;
+    }
+
+    // ["new"|"change"|"delete", price, amount] or [price, amount]
+    bool parseLevels(Cursor& c, const InstrumentSpec& spec, std::vector<LevelUpdate>& out) {
+        return c.array([&] {
+            LevelUpdate level;
+            if (!c.consume('[')) return false;
+            if (c.peek('"')) {
+                std::string_view action;
+                if (!c.string(action) || !c.consume(',') || !c.price(spec, level.price) || !c.consume(',')) return false;
+                if (action == "delete") {
+                    if (!c.skipValue()) return false;
+                } else if (!c.quantity(spec, level.amount)) {
+                    return false;
+                }
+            } else if (!c.price(spec, level.price) || !c.consume(',') || !c.quantity(spec, level.amount)) {
+                return false;
+            }
+            if (!c.consume(']')) return false;
+            out.push_back(level);
+            return true;
+        });
+    }
+
+    bool parseTrades(Cursor& c, const InstrumentSpec& spec) {
+        trades.clear();
+        return c.array([&] {
+            TradeRecord trade;
+            bool ok = c.object([&](std::string_view key) {
+                if (key == "timestamp") return c.integer(trade.timestamp);
+                if (key == "trade_seq") return c.integer(trade.tradeSeq);
+                if (key == "price") return c.price(spec, trade.price);
+                if (key == "amount") return c.quantity(spec, trade.amount);
+                if (key == "direction") {
+                    std::string_view direction;
+                    if (!c.string(direction)) return false;
+                    trade.buy = direction == "buy";
+                    return true;
+                }
+                return c.skipValue();
+            });
+            if (ok) trades.push_back(trade);
+            return ok;
+        });
+    }
+
+    bool parseTicker(Cursor& c, const InstrumentSpec& spec) {
+        ticker = TickerRecord();
+        return c.object([&](std::string_view key) {
+            if (key == "timestamp") return c.integer(ticker.timestamp);
+            if (key == "best_bid_price") return c.null() || c.price(spec, ticker.bestBidPrice);
+            if (key == "best_bid_amount") return c.null() || c.quantity(spec, ticker.bestBidAmount);
+            if (key == "best_ask_price") return c.null() || c.price(spec, ticker.bestAskPrice);
+            if (key == "best_ask_amount") return c.null() || c.quantity(spec, ticker.bestAskAmount);
+            if (key == "last_price") return c.null() || c.price(spec, ticker.lastPrice);
+            if (key == "mark_price") return c.null() || c.real(ticker.markPrice);
+            if (key == "index_price") return c.null() || c.real(ticker.indexPrice);
+            return c.skipValue();
+        });
+    }
+};
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// Exact decimal step such as a tick size of 0.5 or an amount step of 0.0001,
+// kept as `units / 10^decimals` so conversions never depend on the binary
+// representation of the step itself.
+struct DecimalStep {
+    int64_t units = 1;
+    int decimals = 8;
+
+    static int64_t pow10(int n) {
+        int64_t p = 1;
+        while (n-- > 0) p *= 10;
+        return p;
+    }
+
+    static DecimalStep fromDouble(double step) {
+        DecimalStep s;
+        if (!(step > 0)) return s;
+        for (int d = 0; d <= 12; ++d) {
+            double scaled = step * static_cast<double>(pow10(d));
+            double rounded = std::round(scaled);
+            if (rounded >= 1 && std::fabs(scaled - rounded) <= 1e-9 * scaled) {
+                s.units = static_cast<int64_t>(rounded);
+                s.decimals = d;
+                return s;
+            }
+        }
+        return s;
+    }
+
+    // Nearest whole number of steps in `value`
+    int64_t toSteps(double value) const {
+        return std::llround(value * static_cast<double>(pow10(decimals)) / static_cast<double>(units));
+    }
+
+    // Parses decimal text such as "63000.5" straight into steps with integer
+    // arithmetic; exponents and very long numbers fall back to strtod.
+    bool parseSteps(const char* begin, const char* end, int64_t& out) const {
+        const char* p = begin;
+        bool negative = p < end && *p == '-';
+        if (negative) ++p;
+        int64_t mantissa = 0;
+        int digits = 0, fraction = 0;
+        bool dot = false, anyDigit = false;
+        for (; p < end; ++p) {
+            char c = *p;
+            if (c >= '0' && c <= '9') {
+                anyDigit = true;
+                if (digits >= 18) return parseStepsSlow(begin, end, out);
+                mantissa = mantissa * 10 + (c - '0');
+                if (mantissa != 0) ++digits;
+                if (dot) ++fraction;
+            } else if (c == '.' && !dot) {
+                dot = true;
+            } else if (c == 'e' || c == 'E') {
+                return parseStepsSlow(begin, end, out);
+            } else {
+                return false;
+            }
+        }
+        if (!anyDigit) return false;  // "", "-", "."
+        // value = mantissa / 10^fraction, steps = value * 10^decimals / units
+        int shift = decimals - fraction;
+        if (shift >= 0) {
+            if (digits + shift > 18) return parseStepsSlow(begin, end, out);
+            out = roundedDiv(mantissa * pow10(shift), units);
+        } else {
+            if (-shift > 18 - countDigits(units)) return parseStepsSlow(begin, end, out);
+            out = roundedDiv(mantissa, units * pow10(-shift));
+        }
+        if (negative) out = -out;
+        return true;
+    }
+
+    // Single rounding division, so the result is the double closest to the exact decimal
+    double toDouble(int64_t steps) const {
+        return static_cast<double>(steps * units) / static_cast<double>(pow10(decimals));
+    }
+
+    static int64_t roundedDiv(int64_t num, int64_t den) {
+        return (num + den / 2) / den;
+    }
+
+    static int countDigits(int64_t v) {
+        int n = 1;
+        while (v >= 10) { v /= 10; ++n; }
+        return n;
+    }
+
+    bool parseStepsSlow(const char* begin, const char* end, int64_t& out) const {
+        char text[64];
+        size_t len = static_cast<size_t>(end - begin);
+        if (len == 0 || len >= sizeof(text)) return false;
+        std::memcpy(text, begin, len);
+        text[len] = '\0';
+        char* parsedEnd = nullptr;
+        double value = std::strtod(text, &parsedEnd);
+        if (parsedEnd != text + len) return false;
+        out = toSteps(value);
+        return true;
+    }
+};
+
+// Price expressed as an integer number of instrument ticks
+struct Price {
+    int64_t ticks = 0;
+
+    bool operator==(Price o) const { return ticks == o.ticks; }
+    bool operator!=(Price o) const { return ticks != o.ticks; }
+    bool operator<(Price o) const { return ticks < o.ticks; }
+    bool operator>(Price o) const { return ticks > o.ticks; }
+    bool operator<=(Price o) const { return ticks <= o.ticks; }
+    bool operator>=(Price o) const { return ticks >= o.ticks; }
+};
+
+// Amount expressed as an integer number of instrument lots
+struct Quantity {
+    int64_t lots = 0;
+
+    bool operator==(Quantity o) const { return lots == o.lots; }
+    bool operator!=(Quantity o) const { return lots != o.lots; }
+    bool operator<(Quantity o) const { return lots < o.lots; }
+    bool operator>(Quantity o) const { return lots > o.lots; }
+};
+
+// Price/amount grid of one instrument, taken from public/get_instrument.
+// The lot is the smallest amount step the venue accepts: min_trade_amount
+// when it is finer than the contract size (options, spot), otherwise the
+// contract size (futures and perpetuals quote amounts in whole contracts).
+struct InstrumentSpec {
+    std::string name;
+    double tick_size = 1e-8;
+    double contract_size = 1e-8;
+    double min_trade_amount = 1e-8;
+    DecimalStep tick;
+    DecimalStep lot;
+
+    InstrumentSpec() = default;
+
+    InstrumentSpec(const std::string &instrument, double tickSize, double contractSize, double minTradeAmount)
+        : name(instrument), tick_size(tickSize), contract_size(contractSize), min_trade_amount(minTradeAmount),
+          tick(DecimalStep::fromDouble(tickSize)),
+          lot(DecimalStep::fromDouble(minTradeAmount > 0 && minTradeAmount < contractSize ? minTradeAmount : contractSize)) {}
+
+    static InstrumentSpec fromJson(const json &result) {
+        return InstrumentSpec(result.value("instrument_name", std::string()),
+                              result.value("tick_size", 1e-8),
+                              result.value("contract_size", 1e-8),
+                              result.value("min_trade_amount", 1e-8));
+    }
+
+    Price toPrice(double price) const { return Price{tick.toSteps(price)}; }
+    Quantity toQuantity(double amount) const { return Quantity{lot.toSteps(amount)}; }
+    double toDouble(Price p) const { return tick.toDouble(p.ticks); }
+    double toDouble(Quantity q) const { return lot.toDouble(q.lots); }
+
+    // Feed values are converted once at parse time, everything downstream is integer
+    Price parsePrice(const json &v) const { return toPrice(v.get<double>()); }
+    Quantity parseQuantity(const json &v) const { return toQuantity(v.get<double>()); }
+};
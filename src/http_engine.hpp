@@ -0,0 +1,325 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <curl/curl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// Outcome of one HTTP transfer. `error` is empty on success and otherwise
+// holds the text send_request used to throw.
+struct HttpResult {
+    CURLcode code = CURLE_OK;
+    long status = 0;
+    std::string body;
+    std::string error;
+};
+
+using HttpCallback = std::function<void(HttpResult&)>;
+
+// Event-driven HTTP engine on curl_multi's socket-action API.
+// One I/O thread waits on epoll for the sockets and the timer curl asks for
+// and drives every transfer in flight, so the number of concurrent requests is
+// no longer tied to the number of threads blocked in curl_easy_perform.
+// Transfers are handed over from any thread through a queue and an eventfd;
+// all curl_multi calls happen on the I/O thread. Completion callbacks run on
+// that thread too and must not block. The loop also runs delayed tasks
+// (schedule) and cancels transfers on request (cancel).
+class HttpEngine {
+private:
+    struct Transfer {
+        uint64_t id;
+        CURL* easy;
+        std::shared_ptr<curl_slist> headers;  // shared with later requests, not copied
+        std::string request;
+        HttpResult result;
+        HttpCallback done;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    CURLM* multi;
+    const bool multiplex;
+    int epollFd;
+    int wakeFd;
+    std::mutex queueMutex;
+    std::vector<Transfer*> queued;  // submitted, not yet added to the multi handle
+    std::vector<uint64_t> cancelled;  // ids to abort, guarded by queueMutex
+    std::multimap<Clock::time_point, std::function<void()>> tasks;  // guarded by queueMutex
+    std::unordered_map<uint64_t, Transfer*> active;  // added to the multi handle, I/O thread only
+    std::atomic<uint64_t> lastId{0};
+    bool stop = false;
+    bool timerArmed = false;        // I/O thread only
+    Clock::time_point timerDeadline;
+    std::thread ioThread;
+
+    static size_t collect(void* contents, size_t size, size_t nmemb, void* userp) {
+        static_cast<std::string*>(userp)->append(static_cast<char*>(contents), size * nmemb);
+        return size * nmemb;
+    }
+
+    // curl tells us which events it wants on a socket
+    static int onSocket(CURL*, curl_socket_t s, int what, void* userp, void*) {
+        HttpEngine* self = static_cast<HttpEngine*>(userp);
+        if (what == CURL_POLL_REMOVE) {
+            epoll_ctl(self->epollFd, EPOLL_CTL_DEL, s, nullptr);
+            return 0;
+        }
+        epoll_event ev{};
+        ev.data.fd = s;
+        if (what & CURL_POLL_IN) ev.events |= EPOLLIN;
+        if (what & CURL_POLL_OUT) ev.events |= EPOLLOUT;
+        if (epoll_ctl(self->epollFd, EPOLL_CTL_MOD, s, &ev) != 0) {
+            epoll_ctl(self->epollFd, EPOLL_CTL_ADD, s, &ev);
+        }
+        return 0;
+    }
+
+    // curl asks to be called back after timeoutMs (-1 cancels the timer)
+    static int onTimer(CURLM*, long timeoutMs, void* userp) {
+        HttpEngine* self = static_cast<HttpEngine*>(userp);
+        self->timerArmed = timeoutMs >= 0;
+        self->timerDeadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+        return 0;
+    }
+
+    void wake() {
+        uint64_t one = 1;
+        ssize_t written = ::write(wakeFd, &one, sizeof(one));
+        (void)written;
+    }
+
+    void finish(Transfer* t, CURLcode code) {
+        curl_multi_remove_handle(multi, t->easy);
+        active.erase(t->id);
+        curl_easy_getinfo(t->easy, CURLINFO_RESPONSE_CODE, &t->result.status);
+        curl_easy_setopt(t->easy, CURLOPT_HTTPHEADER, nullptr);
+        t->result.code = code;
+        if (code != CURLE_OK) {
+            t->result.error = std::string("CURL Error: ") + curl_easy_strerror(code);
+        }
+        t->done(t->result);
+        delete t;
+    }
+
+    // A transfer that never reached the multi handle
+    static void abandon(Transfer* t) {
+        curl_easy_setopt(t->easy, CURLOPT_HTTPHEADER, nullptr);
+        t->result.code = CURLE_ABORTED_BY_CALLBACK;
+        t->result.error = "HTTP engine stopped";
+        t->done(t->result);
+        delete t;
+    }
+
+    void collectDone() {
+        int pending;
+        while (CURLMsg* msg = curl_multi_info_read(multi, &pending)) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            Transfer* t = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &t);
+            finish(t, msg->data.result);
+        }
+    }
+
+    bool addQueued() {
+        std::vector<Transfer*> batch;
+        std::vector<uint64_t> aborts;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (stop) return false;  // the rest is left for the destructor
+            batch.swap(queued);
+            aborts.swap(cancelled);
+        }
+        for (Transfer* t : batch) {
+            CURLMcode rc = curl_multi_add_handle(multi, t->easy);
+            if (rc == CURLM_OK) {
+                active.emplace(t->id, t);
+            } else {
+                t->result.error = std::string("CURL Error: ") + curl_multi_strerror(rc);
+                t->done(t->result);
+                delete t;
+            }
+        }
+        // Ids no longer active have already completed
+        for (uint64_t id : aborts) {
+            auto it = active.find(id);
+            if (it != active.end()) finish(it->second, CURLE_ABORTED_BY_CALLBACK);
+        }
+        return true;
+    }
+
+    // Runs the delayed tasks that are due and returns the time of the next one
+    Clock::time_point runTasks() {
+        std::vector<std::function<void()>> due;
+        Clock::time_point next = Clock::time_point::max();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            Clock::time_point now = Clock::now();
+            while (!tasks.empty() && tasks.begin()->first <= now) {
+                due.push_back(std::move(tasks.begin()->second));
+                tasks.erase(tasks.begin());
+            }
+            if (!tasks.empty()) next = tasks.begin()->first;
+        }
+        for (auto& task : due) task();
+        return next;
+    }
+
+    void run() {
+        epoll_event events[64];
+        int running = 0;
+        Clock::time_point nextTask = Clock::time_point::max();
+        while (true) {
+            Clock::time_point wakeAt = timerArmed ? std::min(timerDeadline, nextTask) : nextTask;
+            int waitMs = -1;
+            if (wakeAt != Clock::time_point::max()) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(wakeAt - Clock::now()).count();
+                waitMs = left > 0 ? static_cast<int>(left) : 0;
+            }
+            int n = epoll_wait(epollFd, events, 64, waitMs);
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == wakeFd) {
+                    uint64_t count;
+                    ssize_t got = ::read(wakeFd, &count, sizeof(count));
+                    (void)got;
+                    if (!addQueued()) return;
+                    continue;
+                }
+                int flags = 0;
+                if (events[i].events & EPOLLIN) flags |= CURL_CSELECT_IN;
+                if (events[i].events & EPOLLOUT) flags |= CURL_CSELECT_OUT;
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) flags |= CURL_CSELECT_ERR;
+                curl_multi_socket_action(multi, fd, flags, &running);
+            }
+            if (timerArmed && Clock::now() >= timerDeadline) {
+                timerArmed = false;
+                curl_multi_socket_action(multi, CURL_SOCKET_TIMEOUT, 0, &running);
+            }
+            collectDone();
+            nextTask = runTasks();
+        }
+    }
+
+public:
+    // maxConnections caps the multi handle's connection cache, so idle
+    // connections to the host are kept open and reused by later transfers.
+    // With `multiplex` every transfer is an HTTP/2 stream on at most
+    // `hostConnections` connections to the host, `streamsPerConnection` at a
+    // time on each; further transfers wait inside curl for a free stream
+    // instead of opening another connection.
+    explicit HttpEngine(long maxConnections = 10, bool multiplex = false, long hostConnections = 2, long streamsPerConnection = 100)
+        : multiplex(multiplex) {
+        multi = curl_multi_init();
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (!multi || epollFd < 0 || wakeFd < 0) {
+            throw std::runtime_error("Failed to initialise HTTP engine");
+        }
+        curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION, onSocket);
+        curl_multi_setopt(multi, CURLMOPT_SOCKETDATA, this);
+        curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, onTimer);
+        curl_multi_setopt(multi, CURLMOPT_TIMERDATA, this);
+        curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, maxConnections);
+        if (multiplex) {
+            curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+            curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, hostConnections);
+            curl_multi_setopt(multi, CURLMOPT_MAX_CONCURRENT_STREAMS, streamsPerConnection);
+        }
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = wakeFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+        ioThread = std::thread([this] { run(); });
+    }
+
+    // Transfers still in flight are completed with CURLE_ABORTED_BY_CALLBACK
+    ~HttpEngine() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stop = true;
+        }
+        wake();
+        ioThread.join();
+
+        while (!active.empty()) {
+            finish(active.begin()->second, CURLE_ABORTED_BY_CALLBACK);
+        }
+        // Callbacks may post or cancel again; post() refuses from now on
+        std::vector<Transfer*> left;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            left.swap(queued);
+        }
+        for (Transfer* t : left) abandon(t);
+        curl_multi_cleanup(multi);
+        ::close(wakeFd);
+        ::close(epollFd);
+    }
+
+    bool multiplexed() const { return multiplex; }
+
+    // Any thread. POSTs `body` to `url` on `easy`, which stays owned by the
+    // caller and must not be touched until `done` runs. `headers` is held until
+    // then, so one list can serve many requests. Returns the transfer's id for cancel().
+    // Once the engine is stopping, `done` runs at once with an error.
+    uint64_t post(CURL* easy, const std::string& url, std::string body, std::shared_ptr<curl_slist> headers, HttpCallback done) {
+        Transfer* t = new Transfer{++lastId, easy, std::move(headers), std::move(body), HttpResult(), std::move(done)};
+        const uint64_t id = t->id;
+        curl_easy_setopt(easy, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(easy, CURLOPT_POST, 1L);
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDS, t->request.c_str());
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, static_cast<long>(t->request.size()));
+        curl_easy_setopt(easy, CURLOPT_HTTPHEADER, t->headers.get());
+        curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, collect);
+        curl_easy_setopt(easy, CURLOPT_WRITEDATA, &t->result.body);
+        curl_easy_setopt(easy, CURLOPT_PRIVATE, t);
+        // PIPEWAIT: wait for a stream on an existing connection rather than handshake a new one
+        curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, multiplex ? CURL_HTTP_VERSION_2TLS : CURL_HTTP_VERSION_1_1);
+        curl_easy_setopt(easy, CURLOPT_PIPEWAIT, multiplex ? 1L : 0L);
+        bool stopped;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopped = stop;
+            if (!stopped) queued.push_back(t);
+        }
+        if (stopped) {
+            abandon(t);
+            return id;
+        }
+        wake();
+        return id;
+    }
+
+    // Any thread. Aborts the transfer if it is still running; its callback then
+    // runs with CURLE_ABORTED_BY_CALLBACK. Finished ids are ignored.
+    void cancel(uint64_t id) {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            cancelled.push_back(id);
+        }
+        wake();
+    }
+
+    // Any thread. Runs `task` on the I/O thread after `delay`; it must not block.
+    // Tasks still pending at shutdown are dropped.
+    void schedule(std::chrono::microseconds delay, std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            tasks.emplace(Clock::now() + delay, std::move(task));
+        }
+        wake();
+    }
+};
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include "fixed_point.hpp"
+
+// Forward-only cursor over a JSON text, shared by the in-place scanners
+// (FeedParser, RpcResponse). Every method skips leading whitespace, consumes
+// what it reads and returns false on anything unexpected, leaving the caller
+// to fall back to nlohmann::json.
+struct JsonCursor {
+    const char* p;
+    const char* end;
+
+    void skipSpace() {
+        while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) ++p;
+    }
+
+    bool consume(char c) {
+        skipSpace();
+        if (p < end && *p == c) {
+            ++p;
+            return true;
+        }
+        return false;
+    }
+
+    bool peek(char c) {
+        skipSpace();
+        return p < end && *p == c;
+    }
+
+    // String contents without the quotes; escaped strings are not handled here
+    bool string(std::string_view& out) {
+        if (!consume('"')) return false;
+        const char* start = p;
+        while (p < end && *p != '"') {
+            if (*p == '\\') return false;
+            ++p;
+        }
+        if (p >= end) return false;
+        out = std::string_view(start, static_cast<size_t>(p - start));
+        ++p;
+        return true;
+    }
+
+    bool null() {
+        skipSpace();
+        if (end - p >= 4 && std::memcmp(p, "null", 4) == 0) {
+            p += 4;
+            return true;
+        }
+        return false;
+    }
+
+    bool number(const char*& begin, const char*& stop) {
+        skipSpace();
+        begin = p;
+        while (p < end && ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E')) ++p;
+        stop = p;
+        return stop > begin;
+    }
+
+    bool integer(int64_t& out) {
+        skipSpace();
+        bool negative = p < end && *p == '-';
+        if (negative) ++p;
+        if (p >= end || *p < '0' || *p > '9') return false;
+        int64_t value = 0;
+        while (p < end && *p >= '0' && *p <= '9') value = value * 10 + (*p++ - '0');
+        if (p < end && (*p == '.' || *p == 'e' || *p == 'E')) return false;
+        out = negative ? -value : value;
+        return true;
+    }
+
+    bool real(double& out) {
+        const char* b;
+        const char* e;
+        if (!number(b, e)) return false;
+        char text[64];
+        size_t len = static_cast<size_t>(e - b);
+        if (len >= sizeof(text)) return false;
+        std::memcpy(text, b, len);
+        text[len] = '\0';
+        char* parsedEnd = nullptr;
+        out = std::strtod(text, &parsedEnd);
+        return parsedEnd == text + len;
+    }
+
+    bool price(const InstrumentSpec& spec, Price& out) {
+        const char* b;
+        const char* e;
+        return number(b, e) && spec.tick.parseSteps(b, e, out.ticks);
+    }
+
+    bool quantity(const InstrumentSpec& spec, Quantity& out) {
+        const char* b;
+        const char* e;
+        return number(b, e) && spec.lot.parseSteps(b, e, out.lots);
+    }
+
+    // Skips any value, including nested containers and escaped strings
+    bool skipValue() {
+        skipSpace();
+        if (p >= end) return false;
+        if (*p == '"') return skipString();
+        if (*p == '{' || *p == '[') {
+            int depth = 0;
+            while (p < end) {
+                char c = *p;
+                if (c == '"') {
+                    if (!skipString()) return false;
+                    continue;
+                }
+                ++p;
+                if (c == '{' || c == '[') ++depth;
+                else if ((c == '}' || c == ']') && --depth == 0) return true;
+            }
+            return false;
+        }
+        const char* start = p;
+        while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t') ++p;
+        return p > start;
+    }
+
+    // memchr to the next quote; it closes the string unless an odd run of backslashes escapes it
+    bool skipString() {
+        ++p;
+        while (p < end) {
+            const char* quote = static_cast<const char*>(std::memchr(p, '"', static_cast<size_t>(end - p)));
+            if (!quote) break;
+            const char* run = quote;
+            while (run > p && run[-1] == '\\') --run;
+            p = quote + 1;
+            if (((quote - run) & 1) == 0) return true;
+        }
+        p = end;
+        return false;
+    }
+
+    // Calls onMember(key) with the cursor on each value; onMember must consume it
+    template<typename F>
+    bool object(F&& onMember) {
+        if (!consume('{')) return false;
+        if (consume('}')) return true;
+        do {
+            std::string_view key;
+            if (!string(key) || !consume(':') || !onMember(key)) return false;
+        } while (consume(','));
+        return consume('}');
+    }
+
+    template<typename F>
+    bool array(F&& onElement) {
+        if (!consume('[')) return false;
+        if (consume(']')) return true;
+        do {
+            if (!onElement()) return false;
+        } while (consume(','));
+        return consume(']');
+    }
+};
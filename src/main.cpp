@@ -1,6 +1,7 @@
 #include <iostream>
 #include <string>
 #include <unordered_set>
+#include <unordered_map>
 #include <deque>
 #include <queue>
 #include <array>
@@ -15,6 +16,25 @@
 #include <condition_variable>
 #include <immintrin.h>
 #include <atomic>
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <fstream>
+#include <type_traits>
+#include "order_book.hpp"
+#include "feed_parser.hpp"
+#include "feed_dispatcher.hpp"
+#include "book_observer.hpp"
+#include "rpc_tracker.hpp"
+#include "http_engine.hpp"
+#include "admission.hpp"
+#include "credit_limiter.hpp"
+#include "circuit_breaker.hpp"
+#include "order_template.hpp"
+#include "rpc_response.hpp"
+#include "token_store.hpp"
+#include "bulk_runner.hpp"
+#include "order_store.hpp"
 
 
 #define CLIENT_ID "lCQBtKlm"
@@ -23,35 +43,61 @@
 typedef websocketpp::client<websocketpp::config::asio_tls_client> client;
 using json = nlohmann::json;
 
-//  Used by cURL to write the response from the server into a string.
-size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp)
-{
-    ((std::string *)userp)->append((char *)contents, size * nmemb);
-    return size * nmemb;
-}
-
 // Network optimization components
 class ConnectionPool {
 private:
-    std::vector<CURL*> connections;
-    std::mutex pool_mutex;
+    FreeList<CURL> connections;            // lock-free on the acquire/release path
+    std::mutex pool_mutex;                 // only for callers waiting on an empty pool
+    std::condition_variable released;
+    std::atomic<int> waiters{0};
     size_t max_connections;
+    // DNS answers and TLS sessions shared by every handle, so a new connection
+    // skips the lookup and resumes the TLS session instead of a full handshake
+    CURLSH* share;
+    std::mutex share_mutex[CURL_LOCK_DATA_LAST];
+
+    static void lockShare(CURL*, curl_lock_data data, curl_lock_access, void* userp) {
+        static_cast<ConnectionPool*>(userp)->share_mutex[data].lock();
+    }
+
+    static void unlockShare(CURL*, curl_lock_data data, void* userp) {
+        static_cast<ConnectionPool*>(userp)->share_mutex[data].unlock();
+    }
 
 public:
-    ConnectionPool(size_t max_size = 10) : max_connections(max_size) {
+    ConnectionPool(size_t max_size = 10) : connections(max_size), max_connections(max_size) {
+        share = curl_share_init();
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lockShare);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlockShare);
+        curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
         for(size_t i = 0; i < max_size; ++i) {
             CURL* curl = curl_easy_init();
             if(curl) {
                 setupCurlOptions(curl);
-                connections.push_back(curl);
+                connections.tryPush(curl);
             }
         }
     }
 
     ~ConnectionPool() {
-        for(auto curl : connections) {
+        while(CURL* curl = connections.tryPop()) {
             curl_easy_cleanup(curl);
         }
+        curl_share_cleanup(share);
+    }
+
+    size_t size() const { return max_connections; }
+
+    // Extra handle beyond the pool size; release() keeps or cleans it up
+    CURL* create() {
+        CURL* curl = curl_easy_init();
+        if(curl) {
+            setupCurlOptions(curl);
+        }
+        return curl;
     }
 
     void setupCurlOptions(CURL* curl) {
@@ -63,232 +109,108 @@ public:
         curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "gzip, deflate");
         curl_easy_setopt(curl, CURLOPT_HTTP_CONTENT_DECODING, 1L);
         curl_easy_setopt(curl, CURLOPT_ENCODING, "gzip, deflate");
+        curl_easy_setopt(curl, CURLOPT_SHARE, share);
+        curl_easy_setopt(curl, CURLOPT_DNS_CACHE_TIMEOUT, 600L);
     }
 
-    CURL* acquire() {
-        std::lock_guard<std::mutex> lock(pool_mutex);
-        if(connections.empty()) return nullptr;
-        
-        CURL* conn = connections.back();
-        connections.pop_back();
+    // Waits up to `timeout` for a handle to be released, nullptr if none was
+    CURL* acquire(std::chrono::milliseconds timeout = std::chrono::milliseconds(0)) {
+        CURL* conn = connections.tryPop();
+        if(conn || timeout.count() <= 0) return conn;
+
+        // Registered as a waiter before re-checking, so release() either hands
+        // us the handle on the re-check or sees the waiter and notifies
+        std::unique_lock<std::mutex> lock(pool_mutex);
+        ++waiters;
+        released.wait_for(lock, timeout, [this, &conn] { return (conn = connections.tryPop()) != nullptr; });
+        --waiters;
         return conn;
     }
 
     void release(CURL* conn) {
-        std::lock_guard<std::mutex> lock(pool_mutex);
-        if(connections.size() < max_connections) {
-            connections.push_back(conn);
-        } else {
+        if(!connections.tryPush(conn)) {
             curl_easy_cleanup(conn);
+            return;
+        }
+        if(waiters.load() > 0) {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            released.notify_one();
         }
     }
 };
 
-class OrderBook {
+// Per-message latency samples recorded on the feed path without any I/O.
+// Single writer (the WebSocket thread); the samples are printed on demand.
+class LatencyRecorder {
 private:
-    std::map<double, double> bids;  // price -> volume
-    std::map<double, double> asks;  // price -> volume
+    static constexpr size_t CAPACITY = 1 << 16;
+    std::unique_ptr<uint32_t[]> samples = std::make_unique<uint32_t[]>(CAPACITY);
+    std::atomic<uint64_t> written{0};
+    uint64_t reported = 0;
 
 public:
-    void update(const json& data) {
-        if (data.contains("type") && data["type"] == "change") {
-            // Process bids
-            if (data.contains("bids")) {
-                for (const auto& bid : data["bids"]) {
-                    if (bid.is_array() && bid.size() >= 3) {
-                        const auto& action = bid[0];
-                        if (action == "delete") {
-                            if (bid[1].is_number()) {
-                                double price = bid[1].get<double>();
-                                bids.erase(price);
-                            }
-                        } else {
-                            // New or update
-                            if (bid[1].is_number() && bid[2].is_number()) {
-                                double price = bid[1].get<double>();
-                                double volume = bid[2].get<double>();
-                                if (volume > 0) {
-                                    bids[price] = volume;
-                                } else {
-                                    bids.erase(price);
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-
-            // Process asks
-            if (data.contains("asks")) {
-                for (const auto& ask : data["asks"]) {
-                    if (ask.is_array() && ask.size() >= 3) {
-                        const auto& action = ask[0];
-                        if (action == "delete") {
-                            if (ask[1].is_number()) {
-                                double price = ask[1].get<double>();
-                                asks.erase(price);
-                            }
-                        } else {
-                            // New or update
-                            if (ask[1].is_number() && ask[2].is_number()) {
-                                double price = ask[1].get<double>();
-                                double volume = ask[2].get<double>();
-                                if (volume > 0) {
-                                    asks[price] = volume;
-                                } else {
-                                    asks.erase(price);
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-        } else if (data.contains("type") && data["type"] == "snapshot") {
-            // Handle initial snapshot
-            bids.clear();
-            asks.clear();
-
-            if (data.contains("bids")) {
-                for (const auto& bid : data["bids"]) {
-                    if (bid.is_array() && bid.size() >= 2 && 
-                        bid[0].is_number() && bid[1].is_number()) {
-                        double price = bid[0].get<double>();
-                        double volume = bid[1].get<double>();
-                        if (volume > 0) {
-                            bids[price] = volume;
-                        }
-                    }
-                }
-            }
-
-            if (data.contains("asks")) {
-                for (const auto& ask : data["asks"]) {
-                    if (ask.is_array() && ask.size() >= 2 &&
-                        ask[0].is_number() && ask[1].is_number()) {
-                        double price = ask[0].get<double>();
-                        double volume = ask[1].get<double>();
-                        if (volume > 0) {
-                            asks[price] = volume;
-                        }
-                    }
-                }
-            }
-        }
-
-        // Print current state
-        std::cout << "Current Order Book State:" << std::endl;
-        std::cout << "Top Bids:" << std::endl;
-        int count = 0;
-        for (auto it = bids.rbegin(); it != bids.rend() && count < 5; ++it, ++count) {
-            std::cout << "Price: " << it->first << ", Volume: " << it->second << std::endl;
-        }
-
-        std::cout << "\nTop Asks:" << std::endl;
-        count = 0;
-        for (auto it = asks.begin(); it != asks.end() && count < 5; ++it, ++count) {
-            std::cout << "Price: " << it->first << ", Volume: " << it->second << std::endl;
-        }
-    }
-
-    // Getter methods for SIMD processing if needed
-    std::vector<double> getBidPrices() const {
-        std::vector<double> prices;
-        prices.reserve(bids.size());
-        for (const auto& bid : bids) {
-            prices.push_back(bid.first);
-        }
-        return prices;
+    void record(uint32_t micros) {
+        uint64_t n = written.load(std::memory_order_relaxed);
+        samples[n % CAPACITY] = micros;
+        written.store(n + 1, std::memory_order_release);
     }
 
-    std::vector<double> getBidVolumes() const {
-        std::vector<double> volumes;
-        volumes.reserve(bids.size());
-        for (const auto& bid : bids) {
-            volumes.push_back(bid.second);
+    // Hands every sample recorded since the last call to `f`, oldest first.
+    // Samples overwritten in the meantime are skipped.
+    template<typename F>
+    void drain(F f) {
+        uint64_t end = written.load(std::memory_order_acquire);
+        if (end - reported > CAPACITY) reported = end - CAPACITY;
+        for (; reported < end; ++reported) {
+            f(samples[reported % CAPACITY]);
         }
-        return volumes;
     }
-
-    std::vector<double> getAskPrices() const {
-        std::vector<double> prices;
-        prices.reserve(asks.size());
-        for (const auto& ask : asks) {
-            prices.push_back(ask.first);
-        }
-        return prices;
-    }
-
-    std::vector<double> getAskVolumes() const {
-        std::vector<double> volumes;
-        volumes.reserve(asks.size());
-        for (const auto& ask : asks) {
-            volumes.push_back(ask.second);
-        }
-        return volumes;
-    }
-
 };
-// Rate Limiter
-class RateLimiter {
+
+// Recent latencies of one request method, for the adaptive hedge delay
+class LatencyWindow {
 private:
-    std::deque<std::chrono::steady_clock::time_point> request_times;
+    static constexpr size_t SAMPLES = 128;
     std::mutex mutex;
-    const size_t max_requests;
-    const std::chrono::seconds window;
+    std::array<uint32_t, SAMPLES> micros{};
+    size_t count = 0;
 
 public:
-    RateLimiter(size_t max_req = 100, std::chrono::seconds win = std::chrono::seconds(1))
-        : max_requests(max_req), window(win) {}
+    void add(std::chrono::microseconds latency) {
+        std::lock_guard<std::mutex> lock(mutex);
+        micros[count++ % SAMPLES] = static_cast<uint32_t>(std::min<int64_t>(latency.count(), UINT32_MAX));
+    }
 
-    bool shouldThrottle() {
+    // p95 of the recent samples, zero until there are `minSamples` of them
+    std::chrono::microseconds p95(size_t minSamples) {
         std::lock_guard<std::mutex> lock(mutex);
-        auto now = std::chrono::steady_clock::now();
-        
-        while(!request_times.empty() && now - request_times.front() > window) {
-            request_times.pop_front();
-        }
-        
-        if(request_times.size() >= max_requests) {
-            return true;
-        }
-        
-        request_times.push_back(now);
-        return false;
+        if (count < minSamples) return std::chrono::microseconds(0);
+        std::array<uint32_t, SAMPLES> sorted = micros;
+        size_t n = std::min(count, SAMPLES);
+        size_t rank = n * 95 / 100;
+        std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.begin() + n);
+        return std::chrono::microseconds(sorted[rank]);
     }
 };
 
-// Circuit Breaker
-class CircuitBreaker {
-private:
-    std::atomic<int> failure_count{0};
-    std::atomic<bool> is_open{false};
-    std::chrono::steady_clock::time_point last_failure_time;
-    static constexpr int FAILURE_THRESHOLD = 5;
-    static constexpr auto RESET_TIMEOUT = std::chrono::seconds(30);
+// Transport used for private/buy, private/edit and private/cancel.
+// Default defers to the client-wide setting (setOrderTransport).
+enum class OrderTransport { Default, Http, WebSocket };
+
+// Outcome of one order of a bulk batch (executeBulk)
+struct BulkResult {
+    std::string orderId;
+    std::string orderState;
+    std::string error;                      // empty on success
+    std::chrono::microseconds latency{0};   // round trip of the request that carried it
+    bool collapsed = false;                 // cancelled together with others in one request
+    int64_t cancelled = 0;                  // orders cancelled by a cancel-all or cancel-by-label request
+};
 
-public:
-    template<typename Func>
-    auto execute(Func operation) -> decltype(operation()) {
-        if(is_open.load()) {
-            auto now = std::chrono::steady_clock::now();
-            if(now - last_failure_time < RESET_TIMEOUT) {
-                throw std::runtime_error("Circuit breaker is open");
-            }
-            is_open.store(false);
-        }
-        
-        try {
-            auto result = operation();
-            failure_count.store(0);
-            return result;
-        } catch(const std::exception& e) {
-            last_failure_time = std::chrono::steady_clock::now();
-            if(++failure_count >= FAILURE_THRESHOLD) {
-                is_open.store(true);
-            }
-            throw;
-        }
-    }
+struct BulkReport {
+    std::vector<BulkResult> results;        // in the order of the intents
+    std::chrono::microseconds elapsed{0};
+    size_t requests = 0;                    // requests sent, lookups included
 };
 
 // Optimized Trading Client
@@ -296,7 +218,19 @@ class TradingManager {
 private:
     std::string clientId;
     std::string clientSecretId;
-    std::string accessToken;
+    // OAuth tokens of the REST session, replaced by the refresh thread before they
+    // expire. wsTokens belong to the WebSocket connection and die with it.
+    mutable std::mutex tokenMutex;
+    AuthTokens tokens;
+    int64_t tokensIssuedAtMs = 0;
+    AuthTokens wsTokens;
+    int64_t wsTokensIssuedAtMs = 0;
+    std::unique_ptr<TokenCache> tokenCache;           // optional, setTokenCache
+    std::thread tokenRefreshThread;
+    std::condition_variable tokenRefreshWake;
+    bool tokenRefreshStop = false;
+    static constexpr std::chrono::milliseconds TOKEN_RETRY{5000};        // after a failed refresh
+    static constexpr std::chrono::milliseconds TOKEN_MIN_VALIDITY{60000}; // cached tokens closer to expiry are not used
     const std::string baseUrl = "https://test.deribit.com/api/v2/";
     const std::string wsUrl = "wss://test.deribit.com/ws/api/v2/";
     std::unique_ptr<client> wsClient = std::make_unique<client>(); // 1. Unique Pointer Added
@@ -307,12 +241,90 @@ private:
     std::atomic<bool> shouldStop{false}; // 2. Atomic Added
     std::unordered_set<std::string> subscribed_instruments;
     static std::atomic<int> update_counter; // 2. Atomic Added
+
+    // Persistent session state. Everything marked "io thread" is only touched
+    // by websocketpp handlers and timers, which all run on wsThread.
+    static constexpr int HEARTBEAT_SECONDS = 10;      // public/set_heartbeat interval
+    static constexpr long RECONNECT_MIN_MS = 50;      // first retry after a drop
+    static constexpr long RECONNECT_MAX_MS = 5000;    // backoff cap
+    long reconnectDelayMs = RECONNECT_MIN_MS;         // io thread
+    uint64_t sessionGeneration = 0;                   // io thread, bumped on every open
+    bool everConnected = false;                       // io thread
+    std::chrono::steady_clock::time_point disconnectedAt; // io thread
+    std::atomic<int64_t> lastMessageMs{0};            // steady clock, checked by the heartbeat watchdog
+    std::unordered_set<std::string> subscribedChannels; // replayed on every (re)connect
+    std::mutex subscriptionMutex;                     // guards subscribed_instruments and subscribedChannels
+    std::mutex connectedMutex;
+    std::condition_variable connectedCondition;
+    std::atomic<bool> wsAuthenticated{false};         // public/auth acknowledged on the current connection
+
+    // Every JSON-RPC request gets its id here; asynchronous ones wait in the
+    // in-flight table until their response or their timeout
+    RpcTracker rpcTracker;
+    static constexpr int RPC_CHANNEL_HTTP = 0;
+    static constexpr int RPC_CHANNEL_WS = 1;          // failed together when the session drops
+    std::atomic<OrderTransport> orderTransport{OrderTransport::Http};
+    static constexpr std::chrono::milliseconds RPC_TIMEOUT{10000};  // default per-request timeout
     
     
     std::unique_ptr<ConnectionPool> connPool;
-    std::unique_ptr<RateLimiter> rateLimiter;
-    std::unique_ptr<CircuitBreaker> circuitBreaker;
-    OrderBook orderBook;
+    // Requests released by the credit limiter while every HTTP/1.1 handle is busy;
+    // they take the next handle that comes back instead of blocking the pacing thread.
+    // Declared before the engine, whose I/O thread serves them, so they outlive it.
+    struct HandleWaiter {
+        std::chrono::steady_clock::time_point deadline;
+        std::function<void(CURL *)> send;   // nullptr: no handle in time
+    };
+    std::mutex handleWaitMutex;
+    std::deque<HandleWaiter> handleWaiters;
+    std::atomic<size_t> handleWaiting{0};
+    bool handlesClosed = false;                    // set by the destructor, waiters then fail at once
+    CircuitBreakerRegistry circuitBreakers;  // one per REST method, see circuit_breaker.hpp
+    std::unique_ptr<HttpEngine> httpEngine;   // drives every REST transfer, see http_engine.hpp
+    // Deribit credit buckets, paces HTTP and WebSocket requests. Declared after the
+    // engine so its pacing thread is stopped first.
+    CreditLimiter creditLimiter;
+    static constexpr int RATE_LIMIT_RETRIES = 2;   // resends after an exchange 10028 answer
+    static constexpr const char *SHUTDOWN_ERROR = "Client shutting down";  // requests still queued at exit
+    static constexpr size_t BULK_CONCURRENCY = 10;  // bulk requests in flight at once
+    static constexpr size_t BULK_COLLAPSE_MIN = 3;  // cancels of one instrument worth a cancel_all_by_instrument
+    // Opt-in hedging of idempotent public reads: a second copy goes out when the
+    // first has not answered within the method's recent p95
+    std::atomic<bool> hedging{false};
+    static constexpr size_t HEDGE_MIN_SAMPLES = 20;
+    static constexpr std::chrono::microseconds HEDGE_MIN_DELAY{2000};
+    std::mutex hedgeMutex;
+    std::map<std::string, std::unique_ptr<LatencyWindow>> hedgeLatencies;
+    std::atomic<uint64_t> hedgeCalls{0};
+    std::atomic<uint64_t> hedgesSent{0};
+    std::atomic<uint64_t> hedgeWins{0};
+    static constexpr long HTTP2_CONNECTIONS = 2;   // warm TLS connections shared by all streams
+    static constexpr long HTTP2_STREAMS = 100;     // concurrent streams per connection
+    long httpConnections = 10;                     // connections warm-up and keep-alive keep open
+    static constexpr std::chrono::milliseconds ACQUIRE_TIMEOUT{2000};  // wait for a free handle before failing
+    static constexpr int KEEPALIVE_SECONDS = 30;  // idle time before the REST connections are pinged
+    std::atomic<int64_t> lastHttpMs{0};
+    // REST header lists, built once and again only when the token changes
+    std::mutex headerMutex;
+    std::shared_ptr<curl_slist> plainHeaders;
+    std::shared_ptr<curl_slist> bearerHeaders;
+    std::string bearerToken;                       // token bearerHeaders was built for
+    std::thread keepAliveThread;
+    std::mutex keepAliveMutex;
+    std::condition_variable keepAliveWake;
+    bool keepAliveStop = false;
+    OrderBookRegistry bookRegistry; // one book per subscribed instrument
+    BookObserverList bookObservers;  // notified on the shard thread after every book update
+    LatencyRecorder messageLatency;  // ws_message processing time, printed by printMessageLatencies()
+    std::atomic<bool> conflateBooks{false}; // merge pending book updates instead of queueing each one
+    static constexpr int RESYNC_DEPTH = 10000; // full depth, matches the raw book channel
+    std::unordered_map<std::string, InstrumentSpec> instrumentSpecs; // tick/lot grid per instrument
+    std::unordered_map<std::string, std::string> orderInstruments;   // order_id -> instrument_name
+    std::mutex specMutex;
+    // The account's orders, kept current by user.orders notifications once trackOrders() ran
+    OrderStore orderStore;
+    std::atomic<bool> trackingOrders{false};
+    static constexpr const char *ORDERS_CHANNEL = "user.orders.any.any.raw";
     
     
     // Thread Pool
@@ -365,126 +377,981 @@ private:
         }
     };
 
+    // Book, trades and ticker messages are routed to one consumer per shard
+    // through SPSC rings, see feed_dispatcher.hpp. Declared before the pool, whose
+    // resync tasks post to it until the pool is destroyed.
+    FeedDispatcher feedDispatcher;
+
     ThreadPool threadPool;
 
-    // Optimized request sending
-    std::string send_request(const std::string &endpoint, const json &payload, const std::string &token = "") {
-        if(rateLimiter->shouldThrottle()) {
-            throw std::runtime_error("Rate limit exceeded");
+    // Non-blocking request sending. The POST is handed to the HTTP engine, `done`
+    // runs on its I/O thread with the response body or an error and must not block.
+    // Requests without an id get a fresh one from the tracker.
+    // The request waits in the credit limiter until its bucket can pay for it.
+    void post_request(const std::string &endpoint, json payload, const std::string &token, HttpCallback done) {
+        if (!payload.contains("id")) {
+            payload["id"] = rpcTracker.nextId();
         }
+        post_body(endpoint, payload.dump(), token, std::move(done));
+    }
 
-        return circuitBreaker->execute([&]() {
-            std::string readBuffer;
-            CURL* curl = connPool->acquire();
-            
-            if(!curl) {
-                throw std::runtime_error("No available connections");
-            }
+    // Same for a request that is already serialized, id included (order templates).
+    // `onSent` gets the engine's id of every transfer sent for it, so it can be cancelled.
+    void post_body(const std::string &endpoint, std::string body, const std::string &token, HttpCallback done,
+                   std::function<void(uint64_t)> onSent = nullptr) {
+        lastHttpMs.store(steadyMillis(), std::memory_order_relaxed);
+        // Fail fast before spending credits on an endpoint that is down
+        uint64_t ticket = 0;
+        if(!circuitBreakers.get(endpoint).allowRequest(ticket)) {
+            HttpResult failed;
+            failed.error = "Circuit breaker is open for " + endpoint;
+            done(failed);
+            return;
+        }
+        if (hedging.load(std::memory_order_relaxed) && isHedgeable(endpoint)) {
+            postHedged(endpoint, std::move(body), token, ticket, std::move(done), std::move(onSent));
+            return;
+        }
+        queueTransfer(endpoint, std::move(body), token, ticket, std::move(done), 0, std::move(onSent));
+    }
 
-            CURLcode res;
-            struct curl_slist *headers = NULL;
-            
-            try {
-                std::string url = baseUrl + endpoint;
-                curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-                curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    // Public reads that are safe to send twice
+    static bool isHedgeable(const std::string &method) {
+        return method == "public/get_order_book" || method == "public/get_instruments" || method == "public/get_instrument" ||
+               method == "public/ticker" || method == "public/get_index_price" || method == "public/get_book_summary_by_instrument" ||
+               method == "public/get_time" || method == "public/test";
+    }
 
-                std::string jsonStr = payload.dump();
-                curl_easy_setopt(curl, CURLOPT_POSTFIELDS, jsonStr.c_str());
+    LatencyWindow &latencyWindow(const std::string &method) {
+        std::lock_guard<std::mutex> lock(hedgeMutex);
+        auto &window = hedgeLatencies[method];
+        if (!window) window = std::make_unique<LatencyWindow>();
+        return *window;
+    }
 
-                headers = curl_slist_append(headers, "Content-Type: application/json");
-                if (!token.empty()) {
-                    headers = curl_slist_append(headers, ("Authorization: Bearer " + token).c_str());
-                }
-                curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-                curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-                curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-
-                res = curl_easy_perform(curl);
-                
-                if (res != CURLE_OK) {
-                    throw std::runtime_error(std::string("CURL Error: ") + curl_easy_strerror(res));
+    // One call sent up to twice; the first good reply wins and the other transfer is cancelled
+    struct HedgedCall {
+        HttpCallback done;
+        std::atomic<bool> finished{false};
+        std::atomic<int> outstanding{1};
+        std::atomic<uint64_t> primary{0};
+        std::atomic<uint64_t> hedge{0};
+    };
+
+    void postHedged(const std::string &endpoint, std::string body, const std::string &token, uint64_t ticket, HttpCallback done,
+                    std::function<void(uint64_t)> onSent) {
+        auto call = std::make_shared<HedgedCall>();
+        call->done = std::move(done);
+        LatencyWindow &window = latencyWindow(endpoint);
+        ++hedgeCalls;
+
+        // A failed copy waits for the other one if it is still out
+        auto finish = [this, call](bool isHedge, HttpResult &result) {
+            bool failed = !result.error.empty();
+            if (--call->outstanding > 0 && failed) return;
+            if (call->finished.exchange(true)) return;
+            uint64_t other = isHedge ? call->primary.load() : call->hedge.load();
+            if (other) httpEngine->cancel(other);
+            if (isHedge && !failed) ++hedgeWins;
+            call->done(result);
+        };
+        // Sends one copy, records its latency and cancels it if the call was decided meanwhile
+        auto send = [this, endpoint, body, token, ticket, call, finish, onSent, &window](bool isHedge) {
+            auto sentAt = std::chrono::steady_clock::now();
+            transmit(endpoint, body, token, ticket, [call, finish, sentAt, isHedge, &window](HttpResult &result) {
+                if (result.error.empty()) {
+                    window.add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sentAt));
                 }
+                if (result.code == CURLE_ABORTED_BY_CALLBACK && call->finished.load()) return;  // the cancelled loser
+                finish(isHedge, result);
+            }, RATE_LIMIT_RETRIES, [this, call, isHedge, onSent](uint64_t id) {  // no 10028 resend: its transfer could not be cancelled
+                (isHedge ? call->hedge : call->primary).store(id);
+                if (call->finished.load()) httpEngine->cancel(id);
+                if (onSent) onSent(id);
+            });
+        };
+
+        auto drop = [finish](bool isHedge) {
+            HttpResult failed;
+            failed.error = SHUTDOWN_ERROR;
+            finish(isHedge, failed);
+        };
+        creditLimiter.submit(endpoint, [this, endpoint, call, send, drop, &window]() {
+            send(false);
+            std::chrono::microseconds delay = window.p95(HEDGE_MIN_SAMPLES);
+            if (delay.count() == 0) return;  // not enough history yet
+            httpEngine->schedule(std::max(delay, HEDGE_MIN_DELAY), [this, endpoint, call, send, drop]() {
+                if (call->finished.load()) return;
+                ++call->outstanding;
+                ++hedgesSent;
+                creditLimiter.submit(endpoint, [call, send]() {
+                    if (!call->finished.load()) send(true);
+                }, [drop]() { drop(true); });
+            });
+        }, [drop]() { drop(false); });
+    }
+
+    // `ticket` is the circuit breaker's admission, handed back with the outcome
+    void queueTransfer(const std::string &endpoint, std::string body, const std::string &token, uint64_t ticket, HttpCallback done, int attempt,
+                       std::function<void(uint64_t)> onSent = nullptr) {
+        auto drop = [done]() {
+            HttpResult failed;
+            failed.error = SHUTDOWN_ERROR;
+            done(failed);
+        };
+        creditLimiter.submit(endpoint, [this, endpoint, body = std::move(body), token, ticket, done = std::move(done), attempt,
+                                        onSent = std::move(onSent)]() mutable {
+            transmit(endpoint, std::move(body), token, ticket, std::move(done), attempt, std::move(onSent));
+        }, std::move(drop));
+    }
+
+    // Deribit's "too_many_requests"
+    static bool isRateLimited(const std::string &body) {
+        return body.find("\"code\":10028") != std::string::npos;
+    }
+
+    static bool isRateLimited(const json &response) {
+        return response.contains("error") && response["error"].value("code", 0) == 10028;
+    }
+
+    static std::shared_ptr<curl_slist> makeHeaders(const std::string &token) {
+        curl_slist *headers = curl_slist_append(nullptr, "Content-Type: application/json");
+        if (!token.empty()) {
+            headers = curl_slist_append(headers, ("Authorization: Bearer " + token).c_str());
+        }
+        return std::shared_ptr<curl_slist>(headers, curl_slist_free_all);
+    }
 
-                curl_slist_free_all(headers);
-                connPool->release(curl);
-                
-                return readBuffer;
-            } catch (...) {
-                if(headers) curl_slist_free_all(headers);
-                connPool->release(curl);
-                throw;
+    // Cached header list for `token`; in-flight transfers keep the old list alive after a refresh
+    std::shared_ptr<curl_slist> requestHeaders(const std::string &token) {
+        std::lock_guard<std::mutex> lock(headerMutex);
+        if (token.empty()) {
+            if (!plainHeaders) plainHeaders = makeHeaders(token);
+            return plainHeaders;
+        }
+        if (!bearerHeaders || token != bearerToken) {
+            bearerHeaders = makeHeaders(token);
+            bearerToken = token;
+        }
+        return bearerHeaders;
+    }
+
+    // Runs on the credit limiter's pacing thread and never blocks it: without a free
+    // HTTP/1.1 handle the request waits for the next one released, up to ACQUIRE_TIMEOUT.
+    // `onSent` gets the engine's transfer id once the request is handed to the engine.
+    void transmit(const std::string &endpoint, std::string body, const std::string &token, uint64_t ticket, HttpCallback done, int attempt,
+                  std::function<void(uint64_t)> onSent = nullptr) {
+        // With HTTP/2 a handle is only stream state, the burst shares the open connections
+        CURL* curl = connPool->acquire();
+        if(!curl && httpEngine->multiplexed()) {
+            curl = connPool->create();
+        }
+        if(curl) {
+            sendOn(curl, endpoint, std::move(body), token, ticket, std::move(done), attempt, onSent);
+            return;
+        }
+        waitForHandle([this, endpoint, body = std::move(body), token, ticket, done = std::move(done), attempt, onSent](CURL *handle) mutable {
+            if(!handle) {
+                HttpResult failed;
+                circuitBreakers.get(endpoint).record(ticket, false, std::chrono::microseconds(0));
+                failed.error = "No available connections";
+                done(failed);
+                return;
             }
+            sendOn(handle, endpoint, std::move(body), token, ticket, std::move(done), attempt, onSent);
         });
     }
 
-    // Optimized WebSocket message handling
+    // Queues `send` for the next handle released; it gets nullptr after ACQUIRE_TIMEOUT
+    void waitForHandle(std::function<void(CURL *)> send) {
+        {
+            std::lock_guard<std::mutex> lock(handleWaitMutex);
+            if (!handlesClosed) {
+                handleWaiters.push_back({std::chrono::steady_clock::now() + ACQUIRE_TIMEOUT, std::move(send)});
+                handleWaiting.fetch_add(1);
+                send = nullptr;
+            }
+        }
+        if (send) {
+            send(nullptr);
+            return;
+        }
+        httpEngine->schedule(ACQUIRE_TIMEOUT, [this]() { expireHandleWaiters(false); });
+        // Pairs with the fence in releaseHandle(): either we see its handle or it sees us waiting
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        serveHandleWaiters();
+    }
+
+    void releaseHandle(CURL *curl) {
+        connPool->release(curl);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (handleWaiting.load() > 0)
+            serveHandleWaiters();
+    }
+
+    // Hands free handles to waiting requests, oldest first
+    void serveHandleWaiters() {
+        while (true) {
+            std::function<void(CURL *)> send;
+            CURL *curl;
+            {
+                std::lock_guard<std::mutex> lock(handleWaitMutex);
+                if (handleWaiters.empty()) return;
+                curl = connPool->acquire();
+                if (!curl) return;
+                send = std::move(handleWaiters.front().send);
+                handleWaiters.pop_front();
+                handleWaiting.fetch_sub(1);
+            }
+            send(curl);
+        }
+    }
+
+    // Fails the waiters past their deadline, or all of them at shutdown
+    void expireHandleWaiters(bool all) {
+        std::vector<std::function<void(CURL *)>> expired;
+        {
+            std::lock_guard<std::mutex> lock(handleWaitMutex);
+            const auto now = std::chrono::steady_clock::now();
+            while (!handleWaiters.empty() && (all || handleWaiters.front().deadline <= now)) {
+                expired.push_back(std::move(handleWaiters.front().send));
+                handleWaiters.pop_front();
+                handleWaiting.fetch_sub(1);
+            }
+            if (all) handlesClosed = true;
+        }
+        for (auto &send : expired) send(nullptr);
+    }
+
+    uint64_t sendOn(CURL *curl, const std::string &endpoint, std::string body, const std::string &token, uint64_t ticket, HttpCallback done,
+                    int attempt, const std::function<void(uint64_t)> &onSent) {
+        CircuitBreaker &breaker = circuitBreakers.get(endpoint);
+        std::shared_ptr<curl_slist> headers = requestHeaders(token);
+        std::string retryBody = attempt < RATE_LIMIT_RETRIES ? body : std::string();
+        auto sentAt = std::chrono::steady_clock::now();
+        const uint64_t id = httpEngine->post(curl, baseUrl + endpoint, std::move(body), std::move(headers),
+                         [this, curl, &breaker, sentAt, endpoint, token, ticket, attempt, retryBody = std::move(retryBody), done = std::move(done),
+                          onSent](HttpResult &result) mutable {
+            releaseHandle(curl);
+            // Transport errors and 5xx count against the endpoint, exchange-level errors
+            // and transfers we cancelled (hedge losers) do not
+            if (result.code != CURLE_ABORTED_BY_CALLBACK) {
+                breaker.record(ticket, result.error.empty() && result.status < 500,
+                               std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sentAt));
+            }
+            // An aborted transfer is not an answer; at shutdown the limiter may already be gone
+            if (result.code != CURLE_ABORTED_BY_CALLBACK && isRateLimited(result.body)) {
+                creditLimiter.onRejected(endpoint);
+                if (attempt < RATE_LIMIT_RETRIES) {
+                    queueTransfer(endpoint, std::move(retryBody), token, ticket, std::move(done), attempt + 1, std::move(onSent));
+                    return;
+                }
+            }
+            done(result);
+        });
+        if (onSent) onSent(id);
+        return id;
+    }
+
+    // Blocking wrapper over post_request, throws on failure
+    std::string send_request(const std::string &endpoint, json payload, const std::string &token = "") {
+        if (!payload.contains("id")) {
+            payload["id"] = rpcTracker.nextId();
+        }
+        return send_body(endpoint, payload.dump(), token);
+    }
+
+    std::string send_body(const std::string &endpoint, std::string body, const std::string &token = "") {
+        std::promise<HttpResult> promise;
+        std::future<HttpResult> response = promise.get_future();
+        post_body(endpoint, std::move(body), token, [&promise](HttpResult &result) {
+            promise.set_value(std::move(result));
+        });
+        HttpResult result = response.get();
+        if (!result.error.empty()) {
+            throw std::runtime_error(result.error);
+        }
+        return std::move(result.body);
+    }
+
+    // Optimized WebSocket message handling. Book, trades and ticker notifications
+    // are scanned in place by FeedParser; everything else goes through nlohmann::json.
     void ws_message(websocketpp::connection_hdl hdl, client::message_ptr msg) {
-        static thread_local json parser;
-        static thread_local std::string buffer;
+        static thread_local FeedParser feed;
+        static thread_local std::string instrumentKey;
         
         auto start_time = std::chrono::high_resolution_clock::now();
+        lastMessageMs.store(steadyMillis(), std::memory_order_relaxed);
         
-        buffer = msg->get_payload();
-        try {
-            const auto& response = parser.parse(buffer);
-            if (response.contains("params")) {
-                threadPool.enqueue([this, response]() {
+        const std::string &payload = msg->get_payload();
+        OrderBookRegistry::Handle target;
+        FeedParser::Kind kind = feed.parse(payload, [&](std::string_view instrument, FeedParser::Kind k) -> const InstrumentSpec* {
+            instrumentKey.assign(instrument.data(), instrument.size());
+            if (k != FeedParser::Kind::Book) return feedSpec(instrumentKey);
+            target = bookRegistry.find(instrumentKey);
+            return target.book ? &target.book->getSpec() : nullptr;
+        });
+
+        switch (kind) {
+            case FeedParser::Kind::Book:
+                if (conflateBooks.load(std::memory_order_relaxed)) {
+                    conflateBookUpdate(target, feed.book);
+                } else {
+                    // Swapping hands the parsed buffers to the slot and keeps the slot's old ones for the next parse
+                    feedDispatcher.push(target.shard, [&](FeedEvent &event) {
+                        event.type = FeedEvent::Type::Book;
+                        event.book = target.book;
+                        std::swap(event.update, feed.book);
+                    });
+                }
+                break;
+            case FeedParser::Kind::Trades:
+                if (!bookObservers.empty()) {
+                    feedDispatcher.push(bookRegistry.shardFor(instrumentKey), [&](FeedEvent &event) {
+                        event.type = FeedEvent::Type::Trades;
+                        event.instrument = instrumentKey;
+                        std::swap(event.trades, feed.trades);
+                    });
+                }
+                break;
+            case FeedParser::Kind::Ticker:
+                if (!bookObservers.empty()) {
+                    feedDispatcher.push(bookRegistry.shardFor(instrumentKey), [&](FeedEvent &event) {
+                        event.type = FeedEvent::Type::Ticker;
+                        event.instrument = instrumentKey;
+                        event.ticker = feed.ticker;
+                    });
+                }
+                break;
+            case FeedParser::Kind::None:
+                processGenericMessage(payload);
+                break;
+        }
+
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
+        messageLatency.record(static_cast<uint32_t>(duration.count()));
+    }
+
+    // Fallback for frames the feed parser does not handle. Replies to tracked requests
+    // are matched by id before any parse, the tracker parses only for json callbacks.
+    void processGenericMessage(const std::string &payload) {
+        int64_t id = 0;
+        if (RpcResponse::readId(payload, id) && rpcTracker.completeText(id, payload)) {
+            return;
+        }
+        json response = json::parse(payload);
+        if (response.contains("id") && response["id"].is_number_integer() && rpcTracker.complete(response["id"].get<int64_t>(), response)) {
+            return;  // an id the scanner could not read
+        }
+        if (response.value("method", std::string()) == "heartbeat") {
+            // The server asks for a public/test round trip, otherwise it closes the connection
+            if (response.contains("params") && response["params"].value("type", std::string()) == "test_request") {
+                json reply = {{"jsonrpc", "2.0"}, {"method", "public/test"}, {"params", json::object()}, {"id", rpcTracker.nextId()}};
+                sendWebSocketMessage(reply.dump());
+            }
+            return;
+        }
+        if (response.contains("params") && response["params"].is_object() &&
+            response["params"].value("channel", std::string()).compare(0, 12, "user.orders.") == 0 && response["params"].contains("data")) {
+            // Applied here, in arrival order; raw channels carry one order, grouped ones an array
+            const json &data = response["params"]["data"];
+            if (data.is_array()) {
+                for (const auto &order : data) orderStore.apply(order);
+            } else {
+                orderStore.apply(data);
+            }
+            return;
+        }
+        if (response.contains("params")) {
+            // Book notifications go to the shard owning the instrument, everything else to the pool
+            OrderBookRegistry::Handle target = bookFor(response["params"]);
+            if (target.book && conflateBooks.load(std::memory_order_relaxed)) {
+                conflateBookMessage(target, response["params"]);
+            } else if (target.book) {
+                if (!response["params"].contains("data")) return;
+                feedDispatcher.push(target.shard, [&](FeedEvent &event) {
+                    event.type = FeedEvent::Type::Book;
+                    event.book = target.book;
+                    target.book->parse(response["params"]["data"], event.update);
+                });
+            } else {
+                threadPool.enqueue([this, response = std::move(response)]() {
                     processWebSocketMessage(response);
                 });
             }
-        } catch (...) {
-            parser = json();
-            throw;
         }
+    }
 
-        auto end_time = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
-        std::cout << "Message processing latency: " << duration.count() << "µs" << std::endl;
+    // Grid for trades/ticker notifications, from a per-thread copy of the spec cache.
+    // Never fetches: instruments are looked up by subMarketData() before subscribing.
+    const InstrumentSpec* feedSpec(const std::string &instrument) {
+        static thread_local std::unordered_map<std::string, InstrumentSpec> local;
+        auto it = local.find(instrument);
+        if (it != local.end()) return &it->second;
+        std::lock_guard<std::mutex> lock(specMutex);
+        auto shared = instrumentSpecs.find(instrument);
+        if (shared == instrumentSpecs.end()) return nullptr;
+        return &local.emplace(instrument, shared->second).first->second;
+    }
+
+    // A request is either a json payload or an order template, serialized once its id is known
+    static std::string methodOf(const json &payload) { return payload["method"].get<std::string>(); }
+    static std::string methodOf(const OrderRequest &order) { return order.method(); }
+
+    static void serialize(json &payload, int64_t id, std::string &out) {
+        payload["id"] = id;
+        out = payload.dump();
+    }
+
+    static void serialize(const OrderRequest &order, int64_t id, std::string &out) {
+        order.write(out, id);
+    }
+
+    int64_t trackWs(RpcCallback onResponse, std::chrono::milliseconds timeout) {
+        return rpcTracker.track(std::move(onResponse), timeout, RPC_CHANNEL_WS);
+    }
+
+    int64_t trackWs(RpcTextCallback onResponse, std::chrono::milliseconds timeout) {
+        return rpcTracker.trackText(std::move(onResponse), timeout, RPC_CHANNEL_WS);
+    }
+
+    // Sends a JSON-RPC request over the session under a tracked id once the credit
+    // limiter releases it. onResponse runs with the reply, a timeout error, or an
+    // error if the session is down. The timeout counts from here, time spent waiting
+    // for credits included. With Callback = RpcTextCallback it gets the reply
+    // unparsed; the parameter is not deduced, so plain lambdas become an RpcCallback.
+    template <typename Request, typename Callback = RpcCallback>
+    void wsRequest(Request request, std::common_type_t<Callback> onResponse, std::chrono::milliseconds timeout = RPC_TIMEOUT, int attempt = 0) {
+        const std::string method = methodOf(request);
+        Request resend = attempt < RATE_LIMIT_RETRIES ? request : Request();
+        const int64_t id = trackWs(Callback([this, method, resend, onResponse, timeout, attempt](const auto &response) {
+            if (isRateLimited(response)) {
+                creditLimiter.onRejected(method);
+                if (attempt < RATE_LIMIT_RETRIES) {
+                    wsRequest<Request, Callback>(resend, onResponse, timeout, attempt + 1);
+                    return;
+                }
+            }
+            onResponse(response);
+        }), timeout);
+        creditLimiter.submit(method, [this, id, request = std::move(request)]() mutable {
+            if (!rpcTracker.pending(id)) return;  // timed out or failed while waiting for credits
+            if (!isConnected) {
+                rpcTracker.fail(id, "WebSocket not connected");
+                return;
+            }
+            // Pacing-thread buffer, websocketpp copies the frame out of it
+            static thread_local std::string frame;
+            serialize(request, id, frame);
+            websocketpp::lib::error_code ec;
+            wsClient->send(hdl, frame.data(), frame.size(), websocketpp::frame::opcode::text, ec);
+            if (ec) {
+                rpcTracker.fail(id, "WebSocket send failed: " + ec.message());
+            }
+        }, [this, id]() { rpcTracker.fail(id, SHUTDOWN_ERROR); });
+    }
+
+    // HTTP counterpart: the POST is driven by the HTTP engine, the tracker enforces the timeout
+    template <typename Request>
+    void httpRequest(Request request, RpcCallback onResponse, std::chrono::milliseconds timeout = RPC_TIMEOUT) {
+        const int64_t id = rpcTracker.track(std::move(onResponse), timeout, RPC_CHANNEL_HTTP);
+        std::string body;
+        serialize(request, id, body);
+        post_body(methodOf(request), std::move(body), currentToken(), [this, id](HttpResult &result) {
+            if (!result.error.empty()) {
+                rpcTracker.fail(id, result.error);
+                return;
+            }
+            rpcTracker.completeText(id, result.body);
+        }, [this, id](uint64_t transfer) {
+            // A timed out request must not keep its transfer and pool handle
+            auto cancel = [this, transfer]() { httpEngine->cancel(transfer); };
+            if (!rpcTracker.onTimeout(id, cancel)) cancel();
+        });
+    }
+
+    OrderTransport resolveTransport(OrderTransport transport) const {
+        return transport == OrderTransport::Default ? orderTransport.load() : transport;
+    }
+
+    // Request over the chosen transport. The callback runs on the WebSocket thread,
+    // a pool thread or the tracker's timeout thread and must not block.
+    template <typename Request>
+    void dispatchRequest(Request request, OrderTransport transport, std::chrono::milliseconds timeout, RpcCallback onResponse) {
+        if (resolveTransport(transport) == OrderTransport::WebSocket) {
+            wsRequest(std::move(request), std::move(onResponse), timeout);
+        } else {
+            httpRequest(std::move(request), std::move(onResponse), timeout);
+        }
+    }
+
+    template <typename Request>
+    std::future<json> dispatchRequest(Request request, OrderTransport transport, std::chrono::milliseconds timeout) {
+        auto promise = std::make_shared<std::promise<json>>();
+        std::future<json> result = promise->get_future();
+        dispatchRequest(std::move(request), transport, timeout, [promise](const json &response) {
+            promise->set_value(response);
+        });
+        return result;
+    }
+
+    // Blocking form used by the menu functions, returns the raw response for RpcResponse.
+    // HTTP stays on the calling thread as before; the WebSocket reply is handed over as
+    // the frame's text, never parsed into a document.
+    std::string orderRequestBlocking(const OrderRequest &order, const std::string &token) {
+        if (resolveTransport(OrderTransport::Default) == OrderTransport::Http) {
+            std::string body;
+            order.write(body, rpcTracker.nextId());
+            return send_body(order.method(), std::move(body), token);
+        }
+        auto promise = std::make_shared<std::promise<std::string>>();
+        std::future<std::string> reply = promise->get_future();
+        wsRequest<OrderRequest, RpcTextCallback>(order, [promise](const std::string &response) { promise->set_value(response); });
+        return reply.get();
+    }
+
+    // Error text of a blocking response, empty when it succeeded
+    static std::string decodeResponse(const std::string &body, RpcResponse &response) {
+        if (!response.decode(body)) return "Unreadable response: " + body;
+        return response.errorText();
+    }
+
+    // Instrument of an order from the order store or the orders seen here, empty if unknown
+    std::string instrumentOf(const std::string &orderId) {
+        OrderState known;
+        if (orderStore.find(orderId, known) && !known.instrument.empty())
+            return known.instrument;
+        std::lock_guard<std::mutex> lock(specMutex);
+        auto it = orderInstruments.find(orderId);
+        return it == orderInstruments.end() ? std::string() : it->second;
+    }
+
+    // Grid for an order's values; the finest grid when its instrument is not known
+    InstrumentSpec orderSpec(const std::string &orderId) {
+        std::string instrument = instrumentOf(orderId);
+        return instrument.empty() ? InstrumentSpec() : getInstrumentSpec(instrument);
+    }
+
+    // True, with a message, when the synced order store knows the order is no longer
+    // open; the request would only come back with an error
+    bool isClosedLocally(const std::string &orderId) {
+        OrderState known;
+        if (!orderStore.synced() || !orderStore.find(orderId, known) || known.open())
+            return false;
+        std::cerr << "Order " << orderId << " is already " << known.state << ", nothing sent." << std::endl;
+        return true;
+    }
+
+    // Snapshot of the open orders into the store. Over the session it is answered
+    // after the private/subscribe sent before it, so no update falls in between.
+    void seedOrders(OrderTransport transport)
+    {
+        callAsync("private/get_open_orders", json::object(), [this](const json &response) {
+            applyOpenOrders(response);
+        }, transport);
+    }
+
+    bool applyOpenOrders(const json &response) {
+        if (!response.contains("result") || !response["result"].is_array()) {
+            std::cerr << "Failed to load open orders: " << rpcErrorText(response) << std::endl;
+            return false;
+        }
+        // usIn: when the exchange received the request, on the clock of last_update_timestamp
+        const int64_t snapshotMs = response.contains("usIn") && response["usIn"].is_number_integer()
+                                       ? response["usIn"].get<int64_t>() / 1000 : AuthTokens::nowMs();
+        orderStore.seed(response["result"], snapshotMs);
+        std::lock_guard<std::mutex> lock(specMutex);
+        for (const auto &order : response["result"]) {
+            if (order.contains("order_id") && order.contains("instrument_name"))
+                orderInstruments[order["order_id"].get<std::string>()] = order["instrument_name"].get<std::string>();
+        }
+        return true;
+    }
+
+    // Error text of a JSON-RPC response, empty when it succeeded
+    static std::string rpcErrorText(const json &response) {
+        if (response.contains("error")) {
+            const auto &error = response["error"];
+            if (error.contains("data") && error["data"].contains("reason")) return error["data"]["reason"].dump();
+            if (error.contains("message")) return error["message"].dump();
+            return error.dump();
+        }
+        if (response.contains("message")) return response["message"].dump();
+        return std::string();
     }
 
-    void debugPrint(const json& j, const std::string& prefix = "") {
-    std::cout << prefix << j.dump(2) << std::endl;
+    // One request of a bulk batch and the intents it answers
+    struct BulkCall {
+        OrderRequest request;
+        std::vector<size_t> intents;
+    };
+
+    // True when `ids` are exactly the orders of `group`, so a cancel-all sent for
+    // them cancels nothing outside the batch
+    static bool sameOrders(const std::vector<OrderRequest> &orders, const std::vector<size_t> &group, const std::vector<std::string> &ids) {
+        std::unordered_set<std::string> requested;
+        for (size_t i : group) requested.insert(orders[i].orderId);
+        if (requested.size() != group.size() || ids.size() != group.size()) return false;
+        for (const auto &id : ids) {
+            if (!requested.count(id)) return false;
+        }
+        return true;
+    }
+
+    static std::vector<std::string> idsOf(const std::vector<OrderState> &open) {
+        std::vector<std::string> ids;
+        ids.reserve(open.size());
+        for (const auto &order : open) ids.push_back(order.orderId);
+        return ids;
+    }
+
+    // Checks a collapsed call against the live set right before it is sent. Without a
+    // synced order store the lookup made while planning is the latest view there is.
+    bool stillExact(const BulkCall &call, const std::vector<OrderRequest> &orders) {
+        if (!orderStore.synced()) return true;
+        const bool byLabel = call.request.kind == OrderRequest::Kind::CancelByLabel;
+        return sameOrders(orders, call.intents, idsOf(byLabel ? orderStore.openOrdersByLabel(call.request.label)
+                                                              : orderStore.openOrders(call.request.instrument)));
+    }
+
+    // One request per intent. With `collapseCancels`, cancels that are exactly the live
+    // set of a label or of an instrument go out as one cancel_by_label or
+    // cancel_all_by_instrument, which therefore cannot take an order outside the batch.
+    // The synced order store gives the live sets locally, otherwise one lookup per
+    // instrument does (labels need the store). Collapsed calls come first so they are
+    // sent right after the check, and executeBulk checks them once more before sending.
+    std::vector<BulkCall> planBulk(const std::vector<OrderRequest> &orders, OrderTransport transport, bool collapseCancels,
+                                   size_t &lookups) {
+        std::vector<BulkCall> calls;
+        std::vector<BulkCall> single;
+        std::vector<size_t> cancels;
+        lookups = 0;
+        for (size_t i = 0; i < orders.size(); ++i) {
+            if (collapseCancels && orders[i].kind == OrderRequest::Kind::Cancel) cancels.push_back(i);
+            else single.push_back({orders[i], {i}});
+        }
+
+        const bool local = orderStore.synced();
+        if (local) {
+            std::map<std::string, std::vector<size_t>> byLabel;
+            for (size_t i : cancels) {
+                OrderState known;
+                if (orderStore.find(orders[i].orderId, known) && known.open() && !known.label.empty())
+                    byLabel[known.label].push_back(i);
+            }
+            std::unordered_set<size_t> taken;
+            for (const auto &group : byLabel) {
+                if (group.second.size() < BULK_COLLAPSE_MIN) continue;
+                if (!sameOrders(orders, group.second, idsOf(orderStore.openOrdersByLabel(group.first)))) continue;
+                calls.push_back({OrderRequest::cancelByLabel(group.first), group.second});
+                taken.insert(group.second.begin(), group.second.end());
+            }
+            cancels.erase(std::remove_if(cancels.begin(), cancels.end(), [&](size_t i) { return taken.count(i) != 0; }),
+                          cancels.end());
+        }
+
+        std::map<std::string, std::vector<size_t>> byInstrument;
+        for (size_t i : cancels) {
+            std::string instrument = instrumentOf(orders[i].orderId);
+            if (instrument.empty()) single.push_back({orders[i], {i}});
+            else byInstrument[instrument].push_back(i);
+        }
+        std::vector<std::pair<std::string, std::future<json>>> lookupsSent;
+        std::map<std::string, std::vector<std::string>> live;
+        for (const auto &group : byInstrument) {
+            if (group.second.size() < BULK_COLLAPSE_MIN) continue;
+            if (local) {
+                live[group.first] = idsOf(orderStore.openOrders(group.first));
+            } else {
+                lookupsSent.emplace_back(group.first, callAsync("private/get_open_orders_by_instrument",
+                                                                {{"instrument_name", group.first}}, transport));
+            }
+        }
+        lookups = lookupsSent.size();
+        for (auto &lookup : lookupsSent) {
+            json response = lookup.second.get();
+            if (!response.contains("result") || !response["result"].is_array()) continue;
+            std::vector<std::string> &ids = live[lookup.first];
+            for (const auto &order : response["result"]) ids.push_back(order.value("order_id", std::string()));
+        }
+        for (const auto &group : byInstrument) {
+            auto it = live.find(group.first);
+            if (it != live.end() && sameOrders(orders, group.second, it->second)) {
+                calls.push_back({OrderRequest::cancelAll(group.first), group.second});
+                continue;
+            }
+            for (size_t i : group.second) single.push_back({orders[i], {i}});
+        }
+        calls.insert(calls.end(), std::make_move_iterator(single.begin()), std::make_move_iterator(single.end()));
+        return calls;
+    }
+
+    // Spreads a bulk response over the intents of its request
+    void fillBulkResults(const BulkCall &call, const std::vector<OrderRequest> &orders, const json &response,
+                         std::chrono::microseconds latency, std::vector<BulkResult> &results) {
+        std::string error = rpcErrorText(response);
+        const json &result = response.contains("result") ? response["result"] : json();
+        const bool counted = result.is_number_integer();
+        const json &order = result.is_object() && result.contains("order") ? result["order"] : result;
+        if (error.empty() && order.is_object()) rememberOrder(order);
+        for (size_t i : call.intents) {
+            BulkResult &out = results[i];
+            out.latency = latency;
+            out.error = error;
+            out.orderId = orders[i].orderId;
+            out.collapsed = call.intents.size() > 1 || call.request.kind != orders[i].kind;
+            if (!error.empty()) continue;
+            if (counted) {
+                out.cancelled = result.get<int64_t>();
+                if (!out.orderId.empty()) out.orderState = "cancelled";
+            } else if (order.is_object()) {
+                out.orderId = order.value("order_id", out.orderId);
+                out.orderState = order.value("order_state", std::string());
+            }
+        }
+    }
+
+// Book registered for a "book.<instrument>.<interval>" channel, if any
+OrderBookRegistry::Handle bookFor(const json& params) {
+    if (!params.contains("channel") || !params["channel"].is_string()) return {};
+    const std::string& channel = params["channel"].get_ref<const std::string&>();
+    if (channel.compare(0, 5, "book.") != 0) return {};
+    size_t end = channel.find('.', 5);
+    return bookRegistry.find(channel.substr(5, end == std::string::npos ? std::string::npos : end - 5));
+}
+
+// Non-book notifications, run on the thread pool
+void processWebSocketMessage(const json&) {
+    update_counter++;
+}
+
+// Consumer side of the feed dispatcher, runs on the shard thread
+void handleFeedEvent(FeedEvent& event) {
+    switch (event.type) {
+        case FeedEvent::Type::Book:
+            processBookUpdate(*event.book, event.update);
+            break;
+        case FeedEvent::Type::Drain:
+            drainConflated(*event.book, *event.conflation);
+            break;
+        case FeedEvent::Type::Trades:
+            bookObservers.notifyTrades(event.instrument, event.trades);
+            break;
+        case FeedEvent::Type::Ticker:
+            bookObservers.notifyTicker(event.instrument, event.ticker);
+            break;
+        case FeedEvent::Type::Invalidate:
+            event.book->invalidate();
+            bookObservers.notify(event.book->getSpec().name, *event.book, OrderBook::SyncResult::Buffered);
+            break;
+    }
+}
+
+// Conflation mode: merge the update into the instrument's pending state on the feed
+// thread and schedule a single drain on its shard if none is pending yet
+void conflateBookMessage(const OrderBookRegistry::Handle& target, const json& params) {
+    static thread_local BookUpdate incoming;
+    if (!params.contains("data")) return;
+    const auto& data = params["data"];
+    if (!data.contains("type") || (data["type"] != "change" && data["type"] != "snapshot")) return;
+
+    target.book->parse(data, incoming);
+    conflateBookUpdate(target, incoming);
 }
 
-// Replace processWebSocketMessage with this version:
-void processWebSocketMessage(const json& response) {
+void conflateBookUpdate(const OrderBookRegistry::Handle& target, const BookUpdate& incoming) {
+    update_counter++;
+    if (target.conflation->push(incoming)) {
+        feedDispatcher.push(target.shard, [&](FeedEvent &event) {
+            event.type = FeedEvent::Type::Drain;
+            event.book = target.book;
+            event.conflation = target.conflation;
+        });
+    }
+}
+
+void drainConflated(OrderBook& book, ConflationBuffer& conflation) {
+    static thread_local BookUpdate merged;
+    if (!conflation.take(merged)) return;
     try {
-        update_counter++;
-        std::cout << "Update #" << update_counter << std::endl;
-        
-        if (response.contains("params") && response["params"].contains("data")) {
-            const auto& data = response["params"]["data"];
-            // Debug print
-            std::cout << "Received data structure:" << std::endl;
-            debugPrint(data);
-            processOrderBookData(data);
+        OrderBook::SyncResult result = book.apply(merged);
+        if (result == OrderBook::SyncResult::GapDetected) {
+            requestResync(book);
         }
+        bookObservers.notify(book.getSpec().name, book, result);
     } catch (const std::exception& e) {
-        std::cerr << "Error processing WebSocket message: " << e.what() << std::endl;
+        std::cerr << "Error processing order book data: " << e.what() << std::endl;
     }
 }
 
-void processOrderBookData(const json& data) {
+void processBookUpdate(OrderBook& book, const BookUpdate& update) {
+    update_counter++;
     try {
-        orderBook.update(data);
+        OrderBook::SyncResult result = book.apply(update);
+        if (result == OrderBook::SyncResult::GapDetected) {
+            requestResync(book);
+        }
+        bookObservers.notify(book.getSpec().name, book, result);
     } catch (const std::exception& e) {
         std::cerr << "Error processing order book data: " << e.what() << std::endl;
     }
 }
 
+// Fetch a fresh REST snapshot for a book whose change_id chain broke. Runs on the
+// shard owning the book; the fetch happens on the pool and the snapshot is posted
+// back to the shard, where buffered deltas are replayed on top of it.
+void requestResync(OrderBook& book) {
+    book.markResyncRequested();
+    OrderBook *target = &book;
+    const std::string instrument = book.getSpec().name;
+    const size_t shard = bookRegistry.shardFor(instrument);
+    std::cerr << "Order book gap detected for " << instrument << ", resyncing." << std::endl;
+
+    threadPool.enqueue([this, target, instrument, shard]() {
+        BookUpdate snapshot;
+        bool fetched = false;
+        try {
+            json responseJson = fetchOrderBook(instrument, RESYNC_DEPTH);
+            if (responseJson.contains("result")) {
+                target->parse(responseJson["result"], snapshot);
+                fetched = true;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Order book resync failed for " << instrument << ": " << e.what() << std::endl;
+        }
+
+        feedDispatcher.post(shard, [this, target, fetched, snapshot = std::move(snapshot)]() {
+            if (!fetched) {
+                target->resyncFailed();  // the next delta triggers another attempt
+            } else {
+                OrderBook::SyncResult result = target->apply(snapshot);
+                if (result == OrderBook::SyncResult::GapDetected) {
+                    requestResync(*target);
+                }
+                bookObservers.notify(target->getSpec().name, *target, result);
+            }
+        });
+    });
+}
+
+// Remember which instrument an order belongs to, so amendments can use its grid
+void rememberOrder(const json& order) {
+    orderStore.apply(order);
+    if (order.contains("order_id") && order.contains("instrument_name")) {
+        rememberOrder(order["order_id"].get<std::string>(), order["instrument_name"].get<std::string>());
+    }
+}
+
+void rememberOrder(std::string_view orderId, std::string_view instrument) {
+    if (orderId.empty() || instrument.empty()) return;
+    std::lock_guard<std::mutex> lock(specMutex);
+    orderInstruments[std::string(orderId)] = std::string(instrument);
+}
+
+std::string currentToken() const {
+    std::lock_guard<std::mutex> lock(tokenMutex);
+    return tokens.accessToken;
+}
+
+// Takes the tokens of a public/auth result and writes them to the cache
+void storeTokens(const json &result) {
+    AuthTokens fresh = AuthTokens::fromResult(result);
+    {
+        std::lock_guard<std::mutex> lock(tokenMutex);
+        tokens = fresh;
+        tokensIssuedAtMs = AuthTokens::nowMs();
+    }
+    tokenRefreshWake.notify_all();
+    if (tokenCache && !tokenCache->save(fresh)) {
+        std::cerr << "Failed to write token cache " << tokenCache->file() << std::endl;
+    }
+}
+
+json authParams(bool refresh) {
+    if (refresh) {
+        std::lock_guard<std::mutex> lock(tokenMutex);
+        if (!tokens.refreshToken.empty()) return {{"grant_type", "refresh_token"}, {"refresh_token", tokens.refreshToken}};
+    }
+    return {{"grant_type", "client_credentials"}, {"client_id", clientId}, {"client_secret", clientSecretId}};
+}
+
+// Blocking public/auth over REST, with the refresh token or the client credentials
+bool requestTokens(bool refresh) {
+    json payload = {
+        {"method", "public/auth"},
+        {"params", authParams(refresh)},
+        {"jsonrpc", "2.0"}};
+    try {
+        json responseJson = json::parse(send_request("public/auth", payload));
+        if (responseJson.contains("result") && responseJson["result"].contains("access_token")) {
+            storeTokens(responseJson["result"]);
+            return true;
+        }
+        std::cerr << "Failed to authenticate." << std::endl;
+        if (responseJson.contains("error")) {
+            std::cerr << "Error Details: " << responseJson["error"].dump() << std::endl;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Failed to authenticate: " << e.what() << std::endl;
+    }
+    return false;
+}
+
+// Refreshes the REST tokens and the session's before they expire. A refresh token
+// that is refused falls back to the client credentials; failures retry after TOKEN_RETRY.
+void tokenRefreshLoop() {
+    std::unique_lock<std::mutex> lock(tokenMutex);
+    while (!tokenRefreshStop) {
+        const int64_t now = AuthTokens::nowMs();
+        const int64_t restDue = tokens.empty() ? INT64_MAX : tokens.refreshAtMs(tokensIssuedAtMs);
+        const int64_t wsDue = wsTokens.empty() ? INT64_MAX : wsTokens.refreshAtMs(wsTokensIssuedAtMs);
+        const int64_t due = std::min(restDue, wsDue);
+        if (due > now) {
+            if (due == INT64_MAX) tokenRefreshWake.wait(lock);
+            else tokenRefreshWake.wait_for(lock, std::chrono::milliseconds(due - now));
+            continue;
+        }
+        if (wsDue <= now) {
+            std::string refreshToken = wsTokens.refreshToken;
+            wsTokens = AuthTokens();  // the reply brings the next ones
+            lock.unlock();
+            authenticateSession(refreshToken);
+            lock.lock();
+            continue;
+        }
+        lock.unlock();
+        bool ok = requestTokens(true) || requestTokens(false);
+        lock.lock();
+        if (ok) {
+            std::cout << "Access token refreshed." << std::endl;
+        } else {
+            tokenRefreshWake.wait_for(lock, TOKEN_RETRY, [this] { return tokenRefreshStop; });
+        }
+    }
+}
+
+void startTokenRefresh() {
+    std::lock_guard<std::mutex> lock(tokenMutex);
+    if (!tokenRefreshThread.joinable()) {
+        tokenRefreshThread = std::thread([this]() { tokenRefreshLoop(); });
+    }
+}
+
 public:
-    const std::string &getAccessToken() const
+    // Current REST access token, it changes when the refresh thread renews it
+    std::string getAccessToken() const
     {
-        return accessToken;
+        return currentToken();
     }
     TradingManager(const std::string &id, const std::string &secretId)
         : clientId(id), clientSecretId(secretId), 
+          bookRegistry(std::thread::hardware_concurrency()),
+          feedDispatcher(std::thread::hardware_concurrency(), [this](FeedEvent &event) { handleFeedEvent(event); }),
           threadPool(std::thread::hardware_concurrency()) {
         
         connPool = std::make_unique<ConnectionPool>(10);
-        rateLimiter = std::make_unique<RateLimiter>(100, std::chrono::seconds(1));
-        circuitBreaker = std::make_unique<CircuitBreaker>();
+        httpEngine = std::make_unique<HttpEngine>(10);
 
        wsClient->clear_access_channels(websocketpp::log::alevel::all);
         wsClient->clear_error_channels(websocketpp::log::elevel::all);
@@ -492,82 +1359,338 @@ public:
         wsClient->set_open_handler(std::bind(&TradingManager::ws_onOpen, this, std::placeholders::_1));
         wsClient->set_message_handler(std::bind(&TradingManager::ws_message, this, std::placeholders::_1, std::placeholders::_2));
         wsClient->set_close_handler(std::bind(&TradingManager::ws_onClose, this, std::placeholders::_1));
+        wsClient->set_fail_handler(std::bind(&TradingManager::ws_onFail, this, std::placeholders::_1));
+
+        // Set TLS initialization handler
+        wsClient->set_tls_init_handler([](websocketpp::connection_hdl hdl) -> websocketpp::lib::shared_ptr<boost::asio::ssl::context> {
+            websocketpp::lib::shared_ptr<boost::asio::ssl::context> ctx = 
+                websocketpp::lib::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::tlsv12_client);
+            try {
+                ctx->set_verify_mode(boost::asio::ssl::context::verify_none);
+            } catch (const std::exception &e) {
+                std::cerr << "Error initializing SSL context: " << e.what() << std::endl;
+            }
+            return ctx;
+        });
+    }
+    // One public/test per connection, all at once, so each lands on (or opens) its own connection
+    std::vector<std::future<bool>> pingConnections()
+    {
+        std::vector<std::future<bool>> pings;
+        for (long i = 0; i < httpConnections; ++i)
+        {
+            auto done = std::make_shared<std::promise<bool>>();
+            pings.push_back(done->get_future());
+            json payload = {{"jsonrpc", "2.0"}, {"method", "public/test"}, {"params", json::object()}};
+            post_request("public/test", payload, "", [done](HttpResult &result) {
+                done->set_value(result.error.empty());
+            });
+        }
+        return pings;
+    }
+
+    // Pings the REST connections whenever they have been idle for KEEPALIVE_SECONDS,
+    // before the server or a middlebox closes them
+    void keepAliveLoop()
+    {
+        std::unique_lock<std::mutex> lock(keepAliveMutex);
+        while (!keepAliveWake.wait_for(lock, std::chrono::seconds(1), [this] { return keepAliveStop; }))
+        {
+            if (steadyMillis() - lastHttpMs.load(std::memory_order_relaxed) < KEEPALIVE_SECONDS * 1000)
+                continue;
+            lock.unlock();
+            pingConnections();
+            lock.lock();
+        }
     }
+
     // Destructor
     ~TradingManager()
     {
-        if (wsThread->joinable())
         {
-            wsClient->stop();
-            wsThread->join();
+            std::lock_guard<std::mutex> lock(tokenMutex);
+            tokenRefreshStop = true;
+        }
+        tokenRefreshWake.notify_all();
+        if (tokenRefreshThread.joinable())
+            tokenRefreshThread.join();
+
+        {
+            std::lock_guard<std::mutex> lock(keepAliveMutex);
+            keepAliveStop = true;
         }
+        keepAliveWake.notify_all();
+        if (keepAliveThread.joinable())
+            keepAliveThread.join();
 
+        shouldStop = true;
+        wsClient->stop_perpetual();
         if (isConnected)
         {
-            wsClient->close(hdl, websocketpp::close::status::normal, "Closing connection");
+            websocketpp::lib::error_code ec;
+            wsClient->close(hdl, websocketpp::close::status::normal, "Closing connection", ec);
         }
 
+        if (wsThread->joinable())
+        {
+            wsClient->stop();
+            wsThread->join();
+        }
+        expireHandleWaiters(true);
+        feedDispatcher.shutdown();  // its shards enqueue resyncs on the pool, destroyed first
+        rpcTracker.stopTimeouts();  // its HTTP cancels use the engine, destroyed before it
+    }
+
+    static int64_t steadyMillis()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
     }
 
     void ws_onOpen(websocketpp::connection_hdl hdl)
     {
         this->hdl = hdl;
+        ++sessionGeneration;
+        reconnectDelayMs = RECONNECT_MIN_MS;
+        lastMessageMs.store(steadyMillis());
         isConnected = true;
-        std::cout << "WebSocket connection established." << std::endl;
+        if (everConnected)
+        {
+            auto gap = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - disconnectedAt);
+            std::cout << "WebSocket reconnected after " << gap.count() << " ms." << std::endl;
+        }
+        else
+        {
+            std::cout << "WebSocket connection established." << std::endl;
+        }
+        everConnected = true;
+        json heartbeat = {
+            {"jsonrpc", "2.0"},
+            {"method", "public/set_heartbeat"},
+            {"params", {{"interval", HEARTBEAT_SECONDS}}},
+            {"id", rpcTracker.nextId()}};
+        sendWebSocketMessage(heartbeat.dump());
+        authenticateSession();
+        resubscribe(false);
+        scheduleHeartbeatCheck(sessionGeneration);
     }
 
     void ws_onClose(websocketpp::connection_hdl hdl)
     {
-        isConnected = false;
         std::cout << "WebSocket connection closed." << std::endl;
+        connectionLost();
     }
-    // Function to connect websocket
-    void connectWebSocket() 
+
+    void ws_onFail(websocketpp::connection_hdl hdl)
     {
-        // Clean up the previous connection if any
-        if (wsThread && wsThread->joinable()) {
-            wsClient->stop();  // Stop the previous WebSocket client before reusing it
-            wsThread->join();  // Join the previous thread
-            std::cout << "Previous connection stopped and thread joined." << std::endl;
-        }
+        websocketpp::lib::error_code ec;
+        client::connection_ptr con = wsClient->get_con_from_hdl(hdl, ec);
+        std::cerr << "WebSocket connection failed: " << (con ? con->get_ec().message() : ec.message()) << std::endl;
+        connectionLost();
+    }
 
-        // Reinitialize wsClient to ensure it starts fresh for each connection attempt
-        wsClient = std::make_unique<client>();  // Reset the WebSocket client object
+    // Books go stale the moment the feed drops; the Invalidate events travel through
+    // the same rings as the updates, so they land before the resubscription snapshot
+    void connectionLost()
+    {
+        wsAuthenticated = false;
+        orderStore.invalidate();  // updates are missed until the next session seeds it again
+        {
+            std::lock_guard<std::mutex> lock(tokenMutex);
+            wsTokens = AuthTokens();
+        }
+        rpcTracker.failAll(RPC_CHANNEL_WS, "WebSocket disconnected");
+        if (isConnected.exchange(false))
+        {
+            disconnectedAt = std::chrono::steady_clock::now();
+            for (const auto &instrument : bookRegistry.instruments())
+            {
+                OrderBookRegistry::Handle target = bookRegistry.find(instrument);
+                feedDispatcher.push(target.shard, [&](FeedEvent &event) {
+                    event.type = FeedEvent::Type::Invalidate;
+                    event.book = target.book;
+                });
+            }
+        }
+        if (!shouldStop)
+        {
+            scheduleReconnect();
+        }
+    }
 
-        // Clear and reset all WebSocket settings
-        wsClient->clear_access_channels(websocketpp::log::alevel::all);
-        wsClient->clear_error_channels(websocketpp::log::elevel::all);
-        wsClient->init_asio();
-        wsClient->set_open_handler(std::bind(&TradingManager::ws_onOpen, this, std::placeholders::_1));
-        wsClient->set_message_handler(std::bind(&TradingManager::ws_message, this, std::placeholders::_1, std::placeholders::_2));
-        wsClient->set_close_handler(std::bind(&TradingManager::ws_onClose, this, std::placeholders::_1));
+    // Private methods over the WebSocket need the connection itself to be authenticated
+    // (and private channels are only sent once it is). `refreshToken` renews the
+    // session's tokens on the same connection instead of logging in again.
+    void authenticateSession(const std::string &refreshToken = std::string())
+    {
+        const bool refresh = !refreshToken.empty();
+        json params = refresh ? json{{"grant_type", "refresh_token"}, {"refresh_token", refreshToken}}
+                              : json{{"grant_type", "client_credentials"}, {"client_id", clientId}, {"client_secret", clientSecretId}};
+        json payload = {
+            {"jsonrpc", "2.0"},
+            {"method", "public/auth"},
+            {"params", params}};
+        wsRequest(payload, [this, refresh](const json &response) {
+            if (response.contains("result"))
+            {
+                {
+                    std::lock_guard<std::mutex> lock(tokenMutex);
+                    wsTokens = AuthTokens::fromResult(response["result"]);
+                    wsTokensIssuedAtMs = AuthTokens::nowMs();
+                }
+                tokenRefreshWake.notify_all();
+                if (!wsAuthenticated.exchange(true))
+                {
+                    resubscribe(true);
+                    if (trackingOrders)
+                        seedOrders(OrderTransport::WebSocket);
+                }
+            }
+            else if (refresh && response["error"].value("code", 0) != -1)
+            {
+                // Refused by the exchange rather than lost with the connection
+                authenticateSession();
+                return;
+            }
+            else
+            {
+                std::cerr << "WebSocket authentication failed: " << rpcErrorText(response) << std::endl;
+            }
+            {
+                std::lock_guard<std::mutex> lock(connectedMutex);
+            }
+            connectedCondition.notify_all();
+        });
+    }
 
+    bool openConnection()
+    {
         websocketpp::lib::error_code ec;
+        client::connection_ptr con = wsClient->get_connection(wsUrl, ec);
+        if (ec)
+        {
+            std::cerr << "WebSocket connection error: " << ec.message() << std::endl;
+            return false;
+        }
+        wsClient->connect(con);
+        return true;
+    }
+
+    // Exponential backoff, reset by the next successful open
+    void scheduleReconnect()
+    {
+        long delay = reconnectDelayMs;
+        reconnectDelayMs = std::min(reconnectDelayMs * 2, RECONNECT_MAX_MS);
+        wsClient->set_timer(delay, [this](const websocketpp::lib::error_code &ec) {
+            if (ec || shouldStop) return;
+            if (!openConnection()) scheduleReconnect();
+        });
+    }
+
+    // Closes a connection the server has been silent on for two heartbeat intervals,
+    // the close handler then reconnects
+    void scheduleHeartbeatCheck(uint64_t generation)
+    {
+        wsClient->set_timer(HEARTBEAT_SECONDS * 1000, [this, generation](const websocketpp::lib::error_code &ec) {
+            if (ec || shouldStop || generation != sessionGeneration || !isConnected) return;
+            if (steadyMillis() - lastMessageMs.load() > 2 * HEARTBEAT_SECONDS * 1000)
+            {
+                std::cerr << "No heartbeat from server, reconnecting." << std::endl;
+                websocketpp::lib::error_code closeEc;
+                wsClient->close(hdl, websocketpp::close::status::going_away, "Heartbeat timeout", closeEc);
+                return;
+            }
+            scheduleHeartbeatCheck(generation);
+        });
+    }
+
+    // user.* channels need an authenticated session and go through private/subscribe
+    static bool isPrivateChannel(const std::string &channel)
+    {
+        return channel.compare(0, 5, "user.") == 0;
+    }
+
+    void sendSubscription(const char *action, bool privateChannels, const json &channels)
+    {
+        json payload = {
+            {"jsonrpc", "2.0"},
+            {"method", std::string(privateChannels ? "private/" : "public/") + action},
+            {"params", {{"channels", channels}}},
+            {"id", rpcTracker.nextId()}};
+        sendWebSocketMessage(payload.dump());
+    }
+
+    // Public channels are replayed on open, private ones once the session is authenticated
+    void resubscribe(bool privateChannels)
+    {
+        json channels = json::array();
+        {
+            std::lock_guard<std::mutex> lock(subscriptionMutex);
+            for (const auto &channel : subscribedChannels)
+            {
+                if (isPrivateChannel(channel) == privateChannels)
+                    channels.push_back(channel);
+            }
+        }
+        if (channels.empty())
+            return;
+        sendSubscription("subscribe", privateChannels, channels);
+    }
+
+    // Remembered channels are sent now if connected (private ones if authenticated),
+    // otherwise by ws_onOpen or the session's authentication
+    void subscribeChannels(const std::vector<std::string> &channels)
+    {
+        json publicChannels = json::array();
+        json privateChannels = json::array();
+        {
+            std::lock_guard<std::mutex> lock(subscriptionMutex);
+            subscribedChannels.insert(channels.begin(), channels.end());
+        }
+        for (const auto &channel : channels)
+        {
+            (isPrivateChannel(channel) ? privateChannels : publicChannels).push_back(channel);
+        }
+        if (isConnected && !publicChannels.empty())
+            sendSubscription("subscribe", false, publicChannels);
+        if (isConnected && wsAuthenticated && !privateChannels.empty())
+            sendSubscription("subscribe", true, privateChannels);
+    }
 
-        // Set TLS initialization handler
-        wsClient->set_tls_init_handler([](websocketpp::connection_hdl hdl) -> websocketpp::lib::shared_ptr<boost::asio::ssl::context> {
-            websocketpp::lib::shared_ptr<boost::asio::ssl::context> ctx = 
-                websocketpp::lib::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::tlsv12_client);
-            try {
-                ctx->set_verify_mode(boost::asio::ssl::context::verify_none);
-            } catch (const std::exception &e) {
-                std::cerr << "Error initializing SSL context: " << e.what() << std::endl;
+    void unsubscribeChannels(const std::vector<std::string> &channels)
+    {
+        json publicChannels = json::array();
+        json privateChannels = json::array();
+        {
+            std::lock_guard<std::mutex> lock(subscriptionMutex);
+            for (const auto &channel : channels)
+            {
+                subscribedChannels.erase(channel);
+                (isPrivateChannel(channel) ? privateChannels : publicChannels).push_back(channel);
             }
-            return ctx;
-        });
+        }
+        if (isConnected && !publicChannels.empty())
+            sendSubscription("unsubscribe", false, publicChannels);
+        if (isConnected && wsAuthenticated && !privateChannels.empty())
+            sendSubscription("unsubscribe", true, privateChannels);
+    }
 
-        // Create connection and check for errors
-        client::connection_ptr con = wsClient->get_connection(wsUrl, ec);
-        if (ec) {
-            std::cerr << "WebSocket connection error: " << ec.message() << std::endl;
+    // Function to start the WebSocket session. Called once at startup, the session
+    // then stays up: dropped connections are re-established with backoff and every
+    // remembered channel is subscribed again.
+    void connectWebSocket() 
+    {
+        if (wsThread->joinable())
             return;
-        }
 
-        // Connect and start WebSocket client in a new thread
-        wsClient->connect(con);
+        shouldStop = false;
+        wsClient->start_perpetual();  // keep run() alive between connections
+        if (!openConnection())
+        {
+            scheduleReconnect();
+        }
         wsThread = std::make_unique<std::thread>([this]() {
             try {
-                std::cout << "WebSocket client running in a new thread." << std::endl;
                 wsClient->run();
             } catch (const std::exception &e) {
                 std::cerr << "Error in WebSocket thread: " << e.what() << std::endl;
@@ -575,6 +1698,13 @@ public:
         });
     }
 
+    // Function to wait until the session is connected and authenticated, false on timeout
+    bool waitForConnection(std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(connectedMutex);
+        return connectedCondition.wait_for(lock, timeout, [this] { return isConnected.load() && wsAuthenticated.load(); });
+    }
+
 
     // Function to send message through websocket
     void sendWebSocketMessage(const std::string &message)
@@ -589,116 +1719,203 @@ public:
         }
     }
     // Function for Subscribing to orderBook
-    void subOrderBook(const std::string &instrument, int duration_seconds)
+    void subOrderBook(const std::string &instrument)
     {
         std::cout << "Subscribed to:" << instrument << std::endl;
-        subscribed_instruments.insert(instrument);
-        json payload = {
-            {"jsonrpc", "2.0"},
-            {"method", "public/subscribe"},
-            {"params", {{"channels", {"book." + instrument + ".100ms"}}}},
-            {"id", 1}};
-        sendWebSocketMessage(payload.dump());
-        std::thread([this, duration_seconds]
-                    {
-            std::this_thread::sleep_for(std::chrono::seconds(duration_seconds));
-            std::cout << "closing WebSocket connection after " << duration_seconds << " seconds." << std::endl;
-            wsClient->close(hdl, 1000, "Closing after timeout"); })
-            .detach();
+        bookRegistry.getOrCreate(instrument, getInstrumentSpec(instrument));
+        {
+            std::lock_guard<std::mutex> lock(subscriptionMutex);
+            subscribed_instruments.insert(instrument);
+        }
+        subscribeChannels({"book." + instrument + ".100ms"});
+    }
+
+    void unsubOrderBook(const std::string &instrument)
+    {
+        {
+            std::lock_guard<std::mutex> lock(subscriptionMutex);
+            subscribed_instruments.erase(instrument);
+        }
+        unsubscribeChannels({"book." + instrument + ".100ms"});
+    }
+    // Function to subscribe to the trades and ticker channels of an instrument,
+    // delivered to book observers through onTrades()/onTicker()
+    void subMarketData(const std::string &instrument)
+    {
+        getInstrumentSpec(instrument);  // the feed parser needs the grid before the first message
+        subscribeChannels({"trades." + instrument + ".100ms", "ticker." + instrument + ".100ms"});
     }
     // Function to show subscription
     void showSubscriptions()
     {
         std::cout << "Subscribed to:" << std::endl;
+        std::lock_guard<std::mutex> lock(subscriptionMutex);
         for (const auto &instrument : subscribed_instruments)
         {
             std::cout << instrument << std::endl;
         }
     }
-    // Function to authenticate and get accesstoken
-    void authenticate()
+    // Function to register a book observer, called on the shard thread after each update
+    void addBookObserver(const std::shared_ptr<BookObserver> &observer)
     {
-        json payload = {
-            {"id", 0},
-            {"method", "public/auth"},
-            {"params", {{"grant_type", "client_credentials"}, {"client_id", clientId}, {"client_secret", clientSecretId}}},
-            {"jsonrpc", "2.0"}};
+        bookObservers.add(observer);
+    }
+
+    void removeBookObserver(const std::shared_ptr<BookObserver> &observer)
+    {
+        bookObservers.remove(observer);
+    }
+
+    // Function to switch book update conflation on or off. When on, a consumer that
+    // falls behind only sees the latest state of each book instead of every delta.
+    void setConflation(bool enabled)
+    {
+        conflateBooks.store(enabled);
+    }
+
+    bool conflationEnabled() const
+    {
+        return conflateBooks.load();
+    }
 
-        std::string res = send_request("public/auth", payload);
-        auto responseJson = json::parse(res);
-        if (responseJson.contains("result") && responseJson["result"].contains("access_token"))
+    // Function to print how many book updates were coalesced per instrument
+    void printConflationStats()
+    {
+        for (const auto &instrument : bookRegistry.instruments())
         {
-            accessToken = responseJson["result"]["access_token"];
-            std::cout << "Access token retrieved successfully." << std::endl;
+            OrderBookRegistry::Handle handle = bookRegistry.find(instrument);
+            ConflationBuffer::Stats stats = handle.conflation->stats();
+            std::cout << instrument << ": received " << stats.received << ", coalesced " << stats.coalesced
+                      << ", applied " << stats.drained << std::endl;
         }
-        else
+    }
+
+    // Function to print the message processing latencies recorded since the last call
+    void printMessageLatencies()
+    {
+        messageLatency.drain([](uint32_t micros) {
+            std::cout << "Message processing latency: " << micros << "µs\n";
+        });
+        std::cout << std::flush;
+    }
+
+    // Function to read the latest published top of book of a subscribed instrument.
+    // Lock-free and safe from any thread, never blocks the feed handler.
+    bool readTopOfBook(const std::string &instrument, TopOfBook &out) const
+    {
+        OrderBookRegistry::Handle handle = bookRegistry.find(instrument);
+        if (!handle.book)
+            return false;
+        out = handle.book->topOfBook();
+        return true;
+    }
+
+    // Function to get the price/amount grid of a subscribed instrument's book
+    const InstrumentSpec *bookSpec(const std::string &instrument) const
+    {
+        OrderBookRegistry::Handle handle = bookRegistry.find(instrument);
+        return handle.book ? &handle.book->getSpec() : nullptr;
+    }
+
+    // Function to authenticate and get accesstoken. Valid tokens from the token cache are
+    // used without a round trip; either way a background thread refreshes them before expiry.
+    void authenticate()
+    {
+        AuthTokens cached;
+        if (tokenCache && tokenCache->load(cached) && cached.validFor(TOKEN_MIN_VALIDITY))
         {
-            std::cerr << "Failed to authenticate." << std::endl;
-            if (responseJson.contains("error"))
             {
-                std::cerr << "Error Details: " << responseJson["error"].dump() << std::endl;
+                std::lock_guard<std::mutex> lock(tokenMutex);
+                tokens = cached;
+                tokensIssuedAtMs = AuthTokens::nowMs();
             }
+            std::cout << "Access token loaded from cache." << std::endl;
+            startTokenRefresh();
+            return;
+        }
+        if (requestTokens(false))
+        {
+            std::cout << "Access token retrieved successfully." << std::endl;
+            startTokenRefresh();
         }
     }
 
-    // For placing order
+    // Function to keep tokens in an encrypted file (key derived from the client secret),
+    // so the next start skips public/auth. Call before authenticate.
+    void setTokenCache(const std::string &path)
+    {
+        tokenCache = path.empty() ? nullptr : std::make_unique<TokenCache>(path, clientId, clientSecretId);
+    }
+
+    // For placing order, price and amount are snapped to the instrument grid
     void putOrder(const std::string &instrument, const std::string &accessToken, double price, double amount)
     {
-        json payload = {
-            {"jsonrpc", "2.0"},
-            {"method", "private/buy"},
-            {"params", {
-                           {"instrument_name", instrument},
-                           {"type", "limit"},
-                           {"price", price},
-                           {"amount", amount},
-                       }},
-            {"id", 1}};
+        const InstrumentSpec spec = getInstrumentSpec(instrument);
+        Price p = spec.toPrice(price);
+        Quantity q = spec.toQuantity(amount);
+        if (spec.toDouble(p) != price || spec.toDouble(q) != amount)
+        {
+            std::cout << "Order rounded to instrument grid: price " << spec.toDouble(p)
+                      << ", amount " << spec.toDouble(q) << std::endl;
+        }
+        putOrder(instrument, accessToken, p, q);
+    }
+
+    void putOrder(const std::string &instrument, const std::string &accessToken, Price price, Quantity amount)
+    {
+        OrderRequest order = OrderRequest::buy(getInstrumentSpec(instrument), price, amount);
         
         auto start_time = std::chrono::high_resolution_clock::now();
-        std::string response = send_request("private/buy", payload, accessToken);
+        std::string body = orderRequestBlocking(order, accessToken);
         auto end_time = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
 
-        if (!response.empty())
+        RpcResponse response;
+        std::string error = decodeResponse(body, response);
+        if (!error.empty())
         {
-            try
-            {
-                auto responseJson = json::parse(response);
-                if (responseJson.contains("error") && responseJson["error"].contains("data") && responseJson["error"]["data"].contains("reason"))
-                {
-                    std::cerr << "Error Details: " << responseJson["error"]["data"]["reason"] << std::endl;
-                }
-                else if (responseJson.contains("message"))
-                {
-                    std::cerr << "Error Details: " << responseJson["message"] << std::endl;
-                }
-                else
-                {
-                    std::cout << "Order placed successfully." << std::endl;
-                    std::cout << "Order placed Latency : " << duration.count() << " ms" << std::endl;
-                }
-            }
-            catch (const std::exception &e)
-            {
-                std::cerr << "Error parsing JSON response: " << e.what() << std::endl;
-            }
+            std::cerr << "Error Details: " << error << std::endl;
         }
         else
         {
-            std::cout << "No response received or error occurred." << std::endl;
+            rememberOrder(response.orderId, response.instrument);
+            std::cout << "Order placed successfully." << std::endl;
+            std::cout << "Order ID: " << response.orderId << " (" << response.orderState
+                      << ", filled " << response.filledAmount << ")" << std::endl;
+            std::cout << "Order placed Latency : " << duration.count() << " ms" << std::endl;
         }
     }
-    // Function to get all orders
+    // Function to get all orders, from the local order store while it is in sync with
+    // the user.orders feed, otherwise with a private/get_open_orders round trip
     void allOpenOrders()
     {
+        if (orderStore.synced())
+        {
+            std::vector<OrderState> orders = orderStore.openOrders();
+            if (orders.empty())
+            {
+                std::cout << "No open orders found." << std::endl;
+                return;
+            }
+            for (const auto &order : orders)
+            {
+                std::cout << "Order ID: \"" << order.orderId << "\"" << std::endl;
+                std::cout << "Instrument: \"" << order.instrument << "\"" << std::endl;
+                std::cout << "Price: " << order.price << std::endl;
+                std::cout << "Quantity: " << order.amount << " (" << order.direction << ", filled " << order.filledAmount << ")" << std::endl;
+                if (!order.label.empty())
+                    std::cout << "Label: " << order.label << std::endl;
+            }
+            std::cout << orders.size() << " open orders (local)" << std::endl;
+            return;
+        }
+
         json payload = {
             {"jsonrpc", "2.0"},
             {"method", "private/get_open_orders"},
-            {"params", {}},
-            {"id", 2}};
+            {"params", {}}};
 
-        std::string res = send_request("private/get_open_orders", payload, accessToken);
+        std::string res = send_request("private/get_open_orders", payload, currentToken());
         try
         {
             auto responseJson = json::parse(res);
@@ -716,6 +1933,7 @@ public:
                     // Loop through orders safely
                     for (const auto &order : orders)
                     {
+                        rememberOrder(order);
 
                         if (order.contains("order_id"))
                             std::cout << "Order ID: " << order["order_id"] << std::endl;
@@ -747,83 +1965,338 @@ public:
     // Function to cancel order
     void removeOrder(const std::string &accesstoken, const std::string &orderId)
     {
-        json payload = {
-            {"jsonrpc", "2.0"},
-            {"method", "private/cancel"},
-            {"params", {{"order_id", orderId}}},
-            {"id", 3}};
+        if (isClosedLocally(orderId))
+            return;
+        OrderRequest order = OrderRequest::cancel(orderId);
         
         auto start_time = std::chrono::high_resolution_clock::now();
-        std::string response = send_request("private/cancel", payload, accessToken);
-        auto responseJson = json::parse(response);
-        if (responseJson.contains("error"))
+        std::string body = orderRequestBlocking(order, currentToken());
+        RpcResponse response;
+        std::string error = decodeResponse(body, response);
+        if (!error.empty())
         {
-            std::cerr << "Error cancelling order: " << responseJson["error"]["message"] << std::endl;
+            std::cerr << "Error cancelling order: " << error << std::endl;
         }
         else
         {
-            std::cout << "Cancelled Order: " << std::endl;
+            std::cout << "Cancelled Order: " << response.orderId << " (" << response.orderState << ")" << std::endl;
             auto end_time = std::chrono::high_resolution_clock::now();
             auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
             std::cout << "Order Cancelled Latency : " << duration.count() << " ms" << std::endl;
         }
     }
-    // Function to modify order
+    // Function to modify order, values are snapped to the grid when the order's instrument is known
     void modifyOrder(const std::string &accesstoken, const std::string &orderId, double newPrice, double newAmount)
     {
-        json payload = {
-            {"jsonrpc", "2.0"},
-            {"method", "private/edit"},
-            {"params", {{"order_id", orderId}, {"price", newPrice}, {"amount", newAmount}}},
-            {"id", 4}};
+        if (isClosedLocally(orderId))
+            return;
+        const InstrumentSpec spec = orderSpec(orderId);
+        OrderRequest order = OrderRequest::edit(orderId, spec, spec.toPrice(newPrice), spec.toQuantity(newAmount));
         
         auto start_time = std::chrono::high_resolution_clock::now();
 
-        std::string response = send_request("private/edit", payload, accessToken);
-        if (!response.empty())
+        std::string body = orderRequestBlocking(order, currentToken());
+        RpcResponse response;
+        std::string error = decodeResponse(body, response);
+        if (!error.empty())
         {
-            try
-            {
-                auto responseJson = json::parse(response);
-                if (responseJson.contains("error") && responseJson["error"].contains("data") && responseJson["error"]["data"].contains("reason"))
-                {
-                    std::cerr << "Error Details: " << responseJson["error"]["data"]["reason"] << std::endl;
-                }
-                else if (responseJson.contains("message"))
-                {
-                    std::cerr << "Error Details: " << responseJson["message"] << std::endl;
-                }
-                else
-                {
-                    std::cout << "Order modified successfully." << std::endl;
-                    auto end_time = std::chrono::high_resolution_clock::now();
-                    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-                    std::cout << "Order Modified Latency : " << duration.count() << " ms" << std::endl;
+            std::cerr << "Error Details: " << error << std::endl;
+        }
+        else
+        {
+            std::cout << "Order modified successfully." << std::endl;
+            std::cout << "Order ID: " << response.orderId << " (" << response.orderState
+                      << ", filled " << response.filledAmount << ")" << std::endl;
+            auto end_time = std::chrono::high_resolution_clock::now();
+            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+            std::cout << "Order Modified Latency : " << duration.count() << " ms" << std::endl;
+        }
+    }
+    void modifyOrder(const std::string &accesstoken, const std::string &orderId, const std::string &instrument, Price newPrice, Quantity newAmount)
+    {
+        {
+            std::lock_guard<std::mutex> lock(specMutex);
+            orderInstruments[orderId] = instrument;
+        }
+        const InstrumentSpec spec = getInstrumentSpec(instrument);
+        modifyOrder(accesstoken, orderId, spec.toDouble(newPrice), spec.toDouble(newAmount));
+    }
+
+    // Function to turn on hedging of idempotent public reads (getOrderBook,
+    // get_instruments, ticker, ...): a second copy is sent on another connection
+    // when the first has not answered within the method's recent p95 latency
+    void setHedging(bool enabled)
+    {
+        hedging.store(enabled);
+    }
+
+    // Function to switch REST calls to HTTP/2: every request becomes a stream on
+    // at most `connections` TLS connections to the host, `streams` at a time on
+    // each. Call before any request is sent, the engine is replaced.
+    void setHttp2(bool enabled, long streams = HTTP2_STREAMS, long connections = HTTP2_CONNECTIONS)
+    {
+        httpEngine = enabled ? std::make_unique<HttpEngine>(10, true, connections, streams) : std::make_unique<HttpEngine>(10);
+        httpConnections = enabled ? connections : static_cast<long>(connPool->size());
+    }
+
+    // Function to pre-connect the REST connections with cheap public/test calls, so
+    // the first real order does not pay DNS, TCP and TLS setup. Also starts the
+    // keep-alive pings. Call after setHttp2, before trading.
+    void warmUpConnections(std::chrono::milliseconds timeout = std::chrono::milliseconds(5000))
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::future<bool>> pings = pingConnections();
+        size_t warmed = 0;
+        for (auto &ping : pings)
+        {
+            if (ping.wait_until(start + timeout) == std::future_status::ready && ping.get())
+                ++warmed;
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << "Warmed " << warmed << "/" << pings.size() << " REST connections in " << elapsed.count() << " ms." << std::endl;
+
+        std::lock_guard<std::mutex> lock(keepAliveMutex);
+        if (!keepAliveThread.joinable())
+        {
+            keepAliveThread = std::thread([this]() { keepAliveLoop(); });
+        }
+    }
+
+    // Function to keep the account's orders in memory: subscribes to user.orders and
+    // loads the open orders once, then again after every reconnect. allOpenOrders,
+    // removeOrder, modifyOrder and bulk cancels answer from it instead of asking the
+    // exchange. Call after connectWebSocket; false if the orders are not loaded yet,
+    // in which case the session's authentication loads them.
+    bool trackOrders()
+    {
+        trackingOrders.store(true);
+        subscribeChannels({ORDERS_CHANNEL});
+        if (!wsAuthenticated)
+            return false;
+        return applyOpenOrders(callAsync("private/get_open_orders", json::object(), OrderTransport::WebSocket).get());
+    }
+
+    // Function to choose the transport of order entry for calls that do not name one
+    void setOrderTransport(OrderTransport transport)
+    {
+        orderTransport.store(transport == OrderTransport::Default ? OrderTransport::Http : transport);
+    }
+
+    OrderTransport getOrderTransport() const
+    {
+        return orderTransport.load();
+    }
+
+    // Asynchronous order entry. The future or callback receives the full JSON-RPC
+    // response (an "error" member on failure); callbacks must not block.
+    std::future<json> placeOrderAsync(const std::string &instrument, Price price, Quantity amount,
+                                      OrderTransport transport = OrderTransport::Default)
+    {
+        return dispatchRequest(OrderRequest::buy(getInstrumentSpec(instrument), price, amount), transport, RPC_TIMEOUT);
+    }
+
+    void placeOrderAsync(const std::string &instrument, Price price, Quantity amount, RpcCallback onResponse,
+                         OrderTransport transport = OrderTransport::Default)
+    {
+        dispatchRequest(OrderRequest::buy(getInstrumentSpec(instrument), price, amount), transport, RPC_TIMEOUT, std::move(onResponse));
+    }
+
+    std::future<json> editOrderAsync(const std::string &orderId, const std::string &instrument, Price price, Quantity amount,
+                                     OrderTransport transport = OrderTransport::Default)
+    {
+        return dispatchRequest(OrderRequest::edit(orderId, getInstrumentSpec(instrument), price, amount), transport, RPC_TIMEOUT);
+    }
+
+    void editOrderAsync(const std::string &orderId, const std::string &instrument, Price price, Quantity amount,
+                        RpcCallback onResponse, OrderTransport transport = OrderTransport::Default)
+    {
+        dispatchRequest(OrderRequest::edit(orderId, getInstrumentSpec(instrument), price, amount), transport, RPC_TIMEOUT, std::move(onResponse));
+    }
+
+    std::future<json> cancelOrderAsync(const std::string &orderId, OrderTransport transport = OrderTransport::Default)
+    {
+        return dispatchRequest(OrderRequest::cancel(orderId), transport, RPC_TIMEOUT);
+    }
+
+    void cancelOrderAsync(const std::string &orderId, RpcCallback onResponse, OrderTransport transport = OrderTransport::Default)
+    {
+        dispatchRequest(OrderRequest::cancel(orderId), transport, RPC_TIMEOUT, std::move(onResponse));
+    }
+
+    // Function to issue any JSON-RPC method without blocking, e.g. dozens of orders and
+    // cancels back to back. Each request has its own timeout; the tracker delivers
+    // a "Request timed out" error if no response arrives in time.
+    std::future<json> callAsync(const std::string &method, json params, OrderTransport transport = OrderTransport::Default,
+                                std::chrono::milliseconds timeout = RPC_TIMEOUT)
+    {
+        return dispatchRequest(json{{"jsonrpc", "2.0"}, {"method", method}, {"params", std::move(params)}}, transport, timeout);
+    }
+
+    void callAsync(const std::string &method, json params, RpcCallback onResponse, OrderTransport transport = OrderTransport::Default,
+                   std::chrono::milliseconds timeout = RPC_TIMEOUT)
+    {
+        dispatchRequest(json{{"jsonrpc", "2.0"}, {"method", method}, {"params", std::move(params)}}, transport, timeout, std::move(onResponse));
+    }
+
+    // Function to run a batch of order intents (buy, sell, edit, cancel, cancel all by
+    // instrument, cancel by label) with at most `maxInFlight` requests outstanding.
+    // Every request still goes through the credit limiter. Unless `collapseCancels` is
+    // off, cancels that are exactly the live orders of a label or an instrument are
+    // sent as one cancel_by_label or cancel_all_by_instrument (see planBulk).
+    // Blocks until every intent has an answer; results keep the order of `orders`.
+    BulkReport executeBulk(const std::vector<OrderRequest> &orders, size_t maxInFlight = BULK_CONCURRENCY,
+                           OrderTransport transport = OrderTransport::Default, bool collapseCancels = true)
+    {
+        BulkReport report;
+        report.results.resize(orders.size());
+        auto start = std::chrono::steady_clock::now();
+        size_t lookups = 0;
+        std::atomic<size_t> split{0};
+        std::vector<BulkCall> calls = planBulk(orders, transport, collapseCancels, lookups);
+        BoundedBatch batch(calls.size(), maxInFlight, [&](size_t i, BoundedBatch::Done done) {
+            auto sent = std::chrono::steady_clock::now();
+            const BulkCall &call = calls[i];
+            if (call.request.kind != orders[call.intents.front()].kind && !stillExact(call, orders)) {
+                // The live set changed since planning, cancel the orders one by one
+                auto left = std::make_shared<std::atomic<size_t>>(call.intents.size());
+                split += call.intents.size() - 1;
+                for (size_t k : call.intents) {
+                    dispatchRequest(orders[k], transport, RPC_TIMEOUT, [&, k, sent, left, done](const json &response) {
+                        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sent);
+                        fillBulkResults(BulkCall{orders[k], {k}}, orders, response, latency, report.results);
+                        if (--*left == 0) done();
+                    });
                 }
+                return;
             }
-            catch (const std::exception &e)
+            dispatchRequest(calls[i].request, transport, RPC_TIMEOUT, [&, i, sent, done](const json &response) {
+                auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sent);
+                fillBulkResults(calls[i], orders, response, latency, report.results);
+                done();
+            });
+        });
+        batch.wait();
+        report.requests = calls.size() + split.load() + lookups;
+        report.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        return report;
+    }
+
+    BulkReport cancelOrdersBulk(const std::vector<std::string> &orderIds, size_t maxInFlight = BULK_CONCURRENCY,
+                                OrderTransport transport = OrderTransport::Default, bool collapseCancels = true)
+    {
+        std::vector<OrderRequest> orders;
+        orders.reserve(orderIds.size());
+        for (const auto &id : orderIds) orders.push_back(OrderRequest::cancel(id));
+        return executeBulk(orders, maxInFlight, transport, collapseCancels);
+    }
+
+    // Function to cancel the orders listed in a file, one id per line after an
+    // "OrderID" header (the benchmark's order_ids.txt), and print each outcome
+    void removeOrdersFromFile(const std::string &path)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            std::cerr << "Unable to open " << path << std::endl;
+            return;
+        }
+        std::vector<std::string> orderIds;
+        std::string line;
+        while (std::getline(file, line))
+        {
+            line.erase(std::remove_if(line.begin(), line.end(), ::isspace), line.end());
+            if (!line.empty() && line != "OrderID")
+                orderIds.push_back(line);
+        }
+
+        BulkReport report = cancelOrdersBulk(orderIds);
+        for (const auto &result : report.results)
+        {
+            if (!result.error.empty())
+                std::cerr << "Error cancelling order " << result.orderId << ": " << result.error << std::endl;
+            else
+                std::cout << "Cancelled Order: " << result.orderId << " (" << result.orderState << ") in "
+                          << result.latency.count() / 1000.0 << " ms" << (result.collapsed ? " [cancel all]" : "") << std::endl;
+        }
+        std::cout << "Cancelled " << orderIds.size() << " orders with " << report.requests << " requests" << std::endl;
+        std::cout << "Bulk Cancel Latency : " << report.elapsed.count() / 1000.0 << " ms" << std::endl;
+    }
+
+    // Function to print how many requests were sent, answered, failed and timed out
+    void printRpcStats()
+    {
+        RpcTracker::Stats stats = rpcTracker.stats();
+        std::cout << "Requests sent " << stats.sent << ", completed " << stats.completed << ", failed " << stats.failed
+                  << ", timed out " << stats.timedOut << ", in flight " << stats.inFlight << std::endl;
+        circuitBreakers.forEach([](const std::string &method, CircuitBreaker &breaker) {
+            BreakerMetrics m = breaker.metrics();
+            std::cout << "Breaker " << method << ": " << m.state << ", " << m.requests << " calls, error rate " << m.errorRate
+                      << ", p99 " << m.p99Ms << " ms, trips " << m.trips << ", rejected " << m.rejected << std::endl;
+        });
+        if (hedgeCalls.load() > 0) {
+            std::cout << "Hedging: " << hedgeCalls.load() << " calls, " << hedgesSent.load() << " hedged ("
+                      << 100.0 * hedgesSent.load() / hedgeCalls.load() << "%), hedge won " << hedgeWins.load() << std::endl;
+        }
+        CreditLimiter::Stats credits = creditLimiter.stats();
+        std::cout << "Credit limiter sent " << credits.sent << ", paced " << credits.delayed << ", queued " << credits.queued
+                  << ", 10028 rejections " << credits.rejected << std::endl;
+    }
+
+    // Function to get the tick size / contract size of an instrument, cached after the first call
+    InstrumentSpec getInstrumentSpec(const std::string &instrument)
+    {
+        {
+            std::lock_guard<std::mutex> lock(specMutex);
+            auto it = instrumentSpecs.find(instrument);
+            if (it != instrumentSpecs.end())
+                return it->second;
+        }
+
+        json payload = {
+            {"jsonrpc", "2.0"},
+            {"method", "public/get_instrument"},
+            {"params", {{"instrument_name", instrument}}}};
+
+        InstrumentSpec spec;
+        spec.name = instrument;
+        try
+        {
+            auto responseJson = json::parse(send_request("public/get_instrument", payload));
+            if (responseJson.contains("result"))
+            {
+                spec = InstrumentSpec::fromJson(responseJson["result"]);
+                std::lock_guard<std::mutex> lock(specMutex);
+                instrumentSpecs[instrument] = spec;
+            }
+            else
             {
-                std::cerr << "Error parsing JSON response: " << e.what() << std::endl;
+                std::cerr << "Failed to retrieve instrument " << instrument << ", using default precision." << std::endl;
             }
         }
-        else
+        catch (const std::exception &e)
         {
-            std::cout << "No response received or error occurred." << std::endl;
+            std::cerr << "Error retrieving instrument " << instrument << ": " << e.what() << std::endl;
         }
+        return spec;
     }
-    // Function to get orderbook
-    void getOrderBook(const std::string &instrument, int depth)
+
+    // Function to fetch the raw public/get_order_book response
+    json fetchOrderBook(const std::string &instrument, int depth)
     {
         json payload = {
             {"jsonrpc", "2.0"},
             {"method", "public/get_order_book"},
-            {"params", {{"instrument_name", instrument}, {"depth", depth}}},
-            {"id", 5}};
+            {"params", {{"instrument_name", instrument}, {"depth", depth}}}};
+
+        return json::parse(send_request("public/get_order_book", payload));
+    }
 
+    // Function to get orderbook
+    void getOrderBook(const std::string &instrument, int depth)
+    {
         auto start_time = std::chrono::high_resolution_clock::now();
 
-        std::string response = send_request("public/get_order_book", payload);
-        auto responseJson = json::parse(response);
+        auto responseJson = fetchOrderBook(instrument, depth);
 
         if (responseJson.contains("result"))
         {
@@ -871,8 +2344,7 @@ public:
             {"params", {
                            {"currency", currency},
                            {"kind", kind},
-                       }},
-            {"id", 6}};
+                       }}};
         
         auto start_time = std::chrono::high_resolution_clock::now();
         std::string response = send_request("private/get_positions", payload, accessToken);
@@ -887,22 +2359,20 @@ public:
         {
             try
             {
-                auto responseJson = json::parse(response);
-
-                if (responseJson.contains("result"))
+                RpcResponse decoded;
+                if (!decoded.decode(response))
                 {
-                    auto positions = responseJson["result"];
-                    std::cout << positions.dump(4) << std::endl;
-                    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-                    std::cout << "Positions Latency : " << duration.count() << " ms" << std::endl;
+                    std::cerr << "Unexpected response format: " << response << "\n";
                 }
-                else if (responseJson.contains("error") && responseJson["error"].contains("data") && responseJson["error"]["data"].contains("reason"))
+                else if (decoded.ok())
                 {
-                    std::cerr << "Error Details: " << responseJson["error"]["data"]["reason"] << std::endl;
+                    std::cout << decoded.resultJson().dump(4) << std::endl;
+                    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+                    std::cout << "Positions Latency : " << duration.count() << " ms" << std::endl;
                 }
-                else if (responseJson.contains("message"))
+                else if (!decoded.errorText().empty())
                 {
-                    std::cerr << "Error Details: " << responseJson["message"] << std::endl;
+                    std::cerr << "Error Details: " << decoded.errorText() << std::endl;
                 }
                 else
                 {
@@ -921,9 +2391,31 @@ public:
 std::atomic<int> TradingManager::update_counter = 0;
 
 
-int main()
+int main(int argc, char *argv[])
 {
     std::string clientId, clientSecret;
+    bool conflate = false;
+    bool wsOrders = false;
+    bool http2 = false;
+    long http2Streams = 100;
+    bool hedge = false;
+    std::string tokenCache;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--conflate")
+            conflate = true;
+        else if (std::string(argv[i]) == "--ws-orders")
+            wsOrders = true;
+        else if (std::string(argv[i]) == "--http2")
+            http2 = true;
+        else if (std::string(argv[i]) == "--hedge")
+            hedge = true;
+        else if (std::string(argv[i]) == "--http2-streams" && i + 1 < argc)
+            http2Streams = std::atol(argv[++i]);
+        else if (std::string(argv[i]) == "--token-cache" && i + 1 < argc)
+            tokenCache = argv[++i];
+    }
 
     // Input for public and private IDs
     // std::cout << "Enter your publicId: ";
@@ -936,18 +2428,39 @@ int main()
 
     // Creating client object
     TradingManager client(clientId, clientSecret);
+    client.setConflation(conflate);
+    client.setOrderTransport(wsOrders ? OrderTransport::WebSocket : OrderTransport::Http);
+    if (http2)
+        client.setHttp2(true, http2Streams);
+    client.setHedging(hedge);
+    client.setTokenCache(tokenCache);
+
+    // Pre-connect the REST connections so the first order is as fast as the next ones
+    client.warmUpConnections();
 
     // Authenticating
     client.authenticate();
 
     // Check for successful authentication
-    const std::string accessToken = client.getAccessToken();
-    if (accessToken.empty())
+    if (client.getAccessToken().empty())
     {
         std::cerr << "Access token not retrieved. Exiting." << std::endl;
         return 1;
     }
 
+    // One WebSocket session for the whole run, subscriptions made before it is up are sent on open
+    client.connectWebSocket();
+    if (!client.waitForConnection(std::chrono::seconds(5)))
+    {
+        std::cerr << "WebSocket not connected yet, subscriptions will be sent once it is." << std::endl;
+    }
+
+    // Open orders are answered from memory, kept current by the user.orders channel
+    if (!client.trackOrders())
+    {
+        std::cerr << "Open orders not loaded yet, they are fetched from the exchange until they are." << std::endl;
+    }
+
     // Main menu loop
     while (true)
     {
@@ -966,11 +2479,12 @@ int main()
         std::cout << "7. Subscribe to an Orderbook\n";
         std::cout << "8. Show all subscriptions\n";
         std::cout << "9. Exit\n";
+        std::cout << "10. Cancel Orders in Bulk\n";
         std::cout << "Enter your choice: ";
 
         if (!(std::cin >> choice))
         {
-            std::cerr << "Invalid input. Please enter a number between 1 and 9.\n";
+            std::cerr << "Invalid input. Please enter a number between 1 and 10.\n";
             std::cin.clear();                                                   // Clear error state
             std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // Discard invalid input
             continue;
@@ -992,7 +2506,7 @@ int main()
 
             if (!std::cin.fail())
             {
-                client.putOrder(instrument, accessToken, price, amount);
+                client.putOrder(instrument, client.getAccessToken(), price, amount);
             }
             else
             {
@@ -1020,7 +2534,7 @@ int main()
 
             if (!std::cin.fail())
             {
-                client.modifyOrder(accessToken, orderId, price, amount);
+                client.modifyOrder(client.getAccessToken(), orderId, price, amount);
             }
             else
             {
@@ -1036,7 +2550,7 @@ int main()
             std::string orderId;
             std::cout << "Enter order ID: ";
             std::cin >> orderId;
-            client.removeOrder(accessToken, orderId);
+            client.removeOrder(client.getAccessToken(), orderId);
             break;
         }
         case 5:
@@ -1071,7 +2585,7 @@ int main()
             std::cin >> currency;
             std::cout << "Enter kind (e.g., future, option): ";
             std::cin >> kind;
-            client.fetchPositions(accessToken, currency, kind);
+            client.fetchPositions(client.getAccessToken(), currency, kind);
             break;
         }
         case 7:
@@ -1086,10 +2600,17 @@ int main()
 
             if (!std::cin.fail())
             {
-                client.connectWebSocket();
-                std::this_thread::sleep_for(std::chrono::seconds(2)); // Wait for connection
-                client.subOrderBook(instrument, duration);
+                auto renderer = std::make_shared<ConsoleBookRenderer>();
+                client.addBookObserver(renderer);
+                client.subOrderBook(instrument);
                 std::this_thread::sleep_for(std::chrono::seconds(duration));
+                client.unsubOrderBook(instrument);
+                client.removeBookObserver(renderer);
+                client.printMessageLatencies();
+                if (client.conflationEnabled())
+                {
+                    client.printConflationStats();
+                }
             }
             else
             {
@@ -1110,8 +2631,18 @@ int main()
             std::cout << "Exiting program...\n";
             return 0;
 
+        case 10:
+        {
+            // Cancel every order listed in a file
+            std::string path;
+            std::cout << "Enter order ID file: ";
+            std::cin >> path;
+            client.removeOrdersFromFile(path);
+            break;
+        }
+
         default:
-            std::cerr << "Invalid choice. Please select a number between 1 and 9.\n";
+            std::cerr << "Invalid choice. Please select a number between 1 and 10.\n";
             break;
         }
     }
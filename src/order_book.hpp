@@ -0,0 +1,502 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <nlohmann/json.hpp>
+#include "fixed_point.hpp"
+#include "book_snapshot.hpp"
+
+using json = nlohmann::json;
+
+// Read-only view of a ladder: `size` levels in worst -> best order, so the
+// top N levels are the last N elements of both arrays.
+struct LevelView {
+    const int64_t* prices = nullptr;   // ticks
+    const int64_t* volumes = nullptr;  // lots
+    size_t size = 0;
+
+    // View restricted to the best `levels` levels
+    LevelView top(size_t levels) const {
+        size_t n = levels < size ? levels : size;
+        return LevelView{prices + (size - n), volumes + (size - n), n};
+    }
+};
+
+// One side of the order book stored as a flat price ladder.
+// Prices (in ticks) and volumes (in lots) live in two parallel contiguous
+// integer arrays ordered from the worst level to the best one, so the best
+// level always sits at the back: top-of-book reads are O(1), comparisons are
+// exact integer ops and the churn near the touch only shifts a few elements.
+// Capacity is reserved up front and never released, so level inserts and
+// deletes do not allocate in steady state.
+template<typename Compare>
+class BookSide {
+private:
+    std::vector<int64_t> prices;   // worst -> best, in ticks
+    std::vector<int64_t> volumes;  // volumes[i] is the lots resting at prices[i]
+    Compare better;                // better(a, b) is true when a is a better price than b
+
+    // Index of the first level that is not worse than `price`
+    size_t lowerBound(int64_t price) const {
+        return std::lower_bound(prices.begin(), prices.end(), price, better) - prices.begin();
+    }
+
+public:
+    explicit BookSide(size_t capacity = 1024) {
+        prices.reserve(capacity);
+        volumes.reserve(capacity);
+    }
+
+    void clear() {
+        prices.clear();
+        volumes.clear();
+    }
+
+    // Insert or update a level, a non-positive volume removes it
+    void set(Price p, Quantity q) {
+        const int64_t price = p.ticks;
+        const int64_t volume = q.lots;
+        if (volume <= 0) {
+            erase(p);
+            return;
+        }
+        size_t i = lowerBound(price);
+        if (i < prices.size() && prices[i] == price) {
+            volumes[i] = volume;
+        } else {
+            prices.insert(prices.begin() + i, price);
+            volumes.insert(volumes.begin() + i, volume);
+        }
+    }
+
+    void erase(Price p) {
+        const int64_t price = p.ticks;
+        size_t i = lowerBound(price);
+        if (i < prices.size() && prices[i] == price) {
+            prices.erase(prices.begin() + i);
+            volumes.erase(volumes.begin() + i);
+        }
+    }
+
+    bool empty() const { return prices.empty(); }
+    size_t size() const { return prices.size(); }
+
+    // Level accessors counted from the best level (0 = top of book)
+    Price priceAt(size_t level) const { return Price{prices[prices.size() - 1 - level]}; }
+    Quantity volumeAt(size_t level) const { return Quantity{volumes[volumes.size() - 1 - level]}; }
+    Price bestPrice() const { return Price{prices.back()}; }
+    Quantity bestVolume() const { return Quantity{volumes.back()}; }
+
+    // Raw ladder in worst -> best order
+    const std::vector<int64_t>& rawPrices() const { return prices; }
+    const std::vector<int64_t>& rawVolumes() const { return volumes; }
+    LevelView view() const { return LevelView{prices.data(), volumes.data(), prices.size()}; }
+};
+
+// Bids are stored in ascending price order, asks in descending order, so
+// for both sides the best price is at the back of the ladder.
+using BidLadder = BookSide<std::less<int64_t>>;
+using AskLadder = BookSide<std::greater<int64_t>>;
+
+// One price level of a book notification, a zero amount deletes the level
+struct LevelUpdate {
+    Price price;
+    Quantity amount;
+};
+
+// Typed form of one book notification (WebSocket snapshot/change or a REST
+// snapshot), already converted to the instrument grid.
+struct BookUpdate {
+    bool snapshot = false;
+    bool chainBroken = false;   // merged from updates that did not chain, book must resync
+    int64_t changeId = -1;
+    int64_t prevChangeId = -1;  // -1 when the message does not carry one
+    int64_t timestamp = 0;
+    std::vector<LevelUpdate> bids;
+    std::vector<LevelUpdate> asks;
+
+    void clear() {
+        snapshot = chainBroken = false;
+        changeId = prevChangeId = -1;
+        timestamp = 0;
+        bids.clear();
+        asks.clear();
+    }
+
+    // Folds a later update into this one, so applying the result is the same as
+    // applying both in order. Used to conflate updates for slow consumers.
+    void merge(const BookUpdate& next) {
+        if (next.snapshot) {
+            *this = next;
+            return;
+        }
+        if (changeId >= 0 && next.prevChangeId >= 0 && next.prevChangeId != changeId) {
+            chainBroken = true;
+        }
+        mergeLevels(bids, next.bids);
+        mergeLevels(asks, next.asks);
+        changeId = next.changeId;
+        timestamp = std::max(timestamp, next.timestamp);
+    }
+
+private:
+    // Last write wins per price; a snapshot simply drops deleted levels
+    void mergeLevels(std::vector<LevelUpdate>& into, const std::vector<LevelUpdate>& next) {
+        for (const auto& level : next) {
+            auto it = std::find_if(into.begin(), into.end(),
+                                   [&](const LevelUpdate& l) { return l.price == level.price; });
+            if (it != into.end()) {
+                if (snapshot && level.amount.lots <= 0) {
+                    into.erase(it);
+                } else {
+                    it->amount = level.amount;
+                }
+            } else if (!snapshot || level.amount.lots > 0) {
+                into.push_back(level);
+            }
+        }
+    }
+};
+
+class OrderBook {
+public:
+    // Outcome of applying an update
+    enum class SyncResult {
+        Applied,      // book is live and the update was applied
+        Ignored,      // duplicate or already covered by the current state
+        Buffered,     // waiting for a resync snapshot, update kept for replay
+        GapDetected   // change_id chain broken, caller must fetch a fresh snapshot
+    };
+
+    static constexpr size_t MAX_BUFFERED_UPDATES = 4096;
+
+private:
+    InstrumentSpec spec;
+    BidLadder bids;  // price -> volume
+    AskLadder asks;  // price -> volume
+
+    // Sequencing state, Deribit chains every change to the previous one through prev_change_id
+    int64_t lastChangeId = -1;
+    bool resyncing = false;         // chain broken, deltas are buffered until a snapshot arrives
+    bool resyncRequested = false;   // a snapshot fetch is in flight
+    std::vector<BookUpdate> buffered;
+    BookUpdate scratch;             // reused parse target for update(json)
+    int64_t lastTimestamp = 0;
+    Seqlock<TopOfBook> published;   // best levels for readers on other threads
+
+    template<typename Side>
+    static void applyLevels(Side& side, const std::vector<LevelUpdate>& levels) {
+        for (const auto& level : levels) {
+            side.set(level.price, level.amount);
+        }
+    }
+
+    // Accepts both ["new"|"change"|"delete", price, amount] and [price, amount] levels
+    void parseLevels(const json& levels, std::vector<LevelUpdate>& out) const {
+        for (const auto& level : levels) {
+            if (!level.is_array() || level.size() < 2) continue;
+            if (level[0].is_string()) {
+                if (level.size() < 3 || !level[1].is_number()) continue;
+                if (level[0] == "delete") {
+                    out.push_back(LevelUpdate{spec.parsePrice(level[1]), Quantity{0}});
+                } else if (level[2].is_number()) {
+                    // New or update
+                    out.push_back(LevelUpdate{spec.parsePrice(level[1]), spec.parseQuantity(level[2])});
+                }
+            } else if (level[0].is_number() && level[1].is_number()) {
+                out.push_back(LevelUpdate{spec.parsePrice(level[0]), spec.parseQuantity(level[1])});
+            }
+        }
+    }
+
+    void applySnapshot(const BookUpdate& u) {
+        bids.clear();
+        asks.clear();
+        applyLevels(bids, u.bids);
+        applyLevels(asks, u.asks);
+        lastChangeId = u.changeId;
+    }
+
+    void applyChange(const BookUpdate& u) {
+        applyLevels(bids, u.bids);
+        applyLevels(asks, u.asks);
+        lastChangeId = u.changeId;
+    }
+
+    // Replays the deltas buffered during a resync on top of a fresh snapshot
+    SyncResult replayBuffered() {
+        std::vector<BookUpdate> pending;
+        pending.swap(buffered);
+        for (auto& u : pending) {
+            if (u.changeId <= lastChangeId) continue;
+            if (u.prevChangeId != lastChangeId) {
+                // Snapshot does not line up with what was buffered, keep the rest and retry
+                resyncing = true;
+                for (auto& rest : pending) {
+                    if (rest.changeId > lastChangeId) buffered.push_back(std::move(rest));
+                }
+                return SyncResult::GapDetected;
+            }
+            applyChange(u);
+        }
+        return SyncResult::Applied;
+    }
+
+public:
+    explicit OrderBook(const InstrumentSpec& instrumentSpec = InstrumentSpec()) : spec(instrumentSpec) {}
+
+    // Switch to another instrument grid, the book is emptied
+    void reset(const InstrumentSpec& instrumentSpec) {
+        spec = instrumentSpec;
+        bids.clear();
+        asks.clear();
+        lastChangeId = -1;
+        lastTimestamp = 0;
+        resyncing = resyncRequested = false;
+        buffered.clear();
+        publish();
+    }
+
+    const InstrumentSpec& getSpec() const { return spec; }
+    int64_t getChangeId() const { return lastChangeId; }
+    bool isResyncing() const { return resyncing; }
+
+    // Converts a book notification or a public/get_order_book result to typed form
+    void parse(const json& data, BookUpdate& out) const {
+        out.clear();
+        // REST results carry no type and are always full snapshots
+        out.snapshot = !data.contains("type") || data["type"] == "snapshot";
+        if (data.contains("change_id") && data["change_id"].is_number())
+            out.changeId = data["change_id"].get<int64_t>();
+        if (data.contains("prev_change_id") && data["prev_change_id"].is_number())
+            out.prevChangeId = data["prev_change_id"].get<int64_t>();
+        if (data.contains("timestamp") && data["timestamp"].is_number())
+            out.timestamp = data["timestamp"].get<int64_t>();
+        if (data.contains("bids")) parseLevels(data["bids"], out.bids);
+        if (data.contains("asks")) parseLevels(data["asks"], out.asks);
+    }
+
+    // Copies the best levels into the seqlock, called by the owning shard after each update
+    void publish() {
+        TopOfBook top;
+        top.changeId = lastChangeId;
+        top.timestamp = lastTimestamp;
+        top.resyncing = resyncing ? 1 : 0;
+        top.bidCount = static_cast<uint32_t>(std::min(bids.size(), TopOfBook::DEPTH));
+        top.askCount = static_cast<uint32_t>(std::min(asks.size(), TopOfBook::DEPTH));
+        for (uint32_t i = 0; i < top.bidCount; ++i) {
+            top.bidPrices[i] = bids.priceAt(i).ticks;
+            top.bidVolumes[i] = bids.volumeAt(i).lots;
+        }
+        for (uint32_t i = 0; i < top.askCount; ++i) {
+            top.askPrices[i] = asks.priceAt(i).ticks;
+            top.askVolumes[i] = asks.volumeAt(i).lots;
+        }
+        published.store(top);
+    }
+
+    // Wait-free for the writer, lock-free for readers: safe to call from any thread
+    TopOfBook topOfBook() const { return published.load(); }
+    uint64_t publishedVersion() const { return published.version(); }
+
+    // Applies an update and publishes the new top of book when the book changed
+    SyncResult apply(const BookUpdate& u) {
+        SyncResult result = applyUpdate(u);
+        if (result == SyncResult::Applied || result == SyncResult::GapDetected) {
+            if (u.timestamp > lastTimestamp) lastTimestamp = u.timestamp;
+            publish();
+        }
+        return result;
+    }
+
+private:
+    SyncResult applyUpdate(const BookUpdate& u) {
+        if (u.chainBroken) {
+            // Conflated across a gap, the merged levels cannot be trusted
+            if (u.snapshot) applySnapshot(u);
+            resyncing = true;
+            buffered.clear();
+            return resyncRequested ? SyncResult::Buffered : SyncResult::GapDetected;
+        }
+
+        if (u.snapshot) {
+            applySnapshot(u);
+            resyncRequested = false;
+            if (!resyncing) return SyncResult::Applied;
+            resyncing = false;
+            return replayBuffered();
+        }
+
+        if (resyncing) {
+            if (buffered.size() >= MAX_BUFFERED_UPDATES) {
+                buffered.clear();  // the next snapshot will not chain and triggers another fetch
+            }
+            buffered.push_back(u);
+            return resyncRequested ? SyncResult::Buffered : SyncResult::GapDetected;
+        }
+
+        if (lastChangeId >= 0 && u.prevChangeId >= 0 && u.prevChangeId != lastChangeId) {
+            if (u.changeId <= lastChangeId) {
+                return SyncResult::Ignored;
+            }
+            resyncing = true;
+            buffered.clear();
+            buffered.push_back(u);
+            return SyncResult::GapDetected;
+        }
+
+        applyChange(u);
+        return SyncResult::Applied;
+    }
+
+public:
+    // Called once a snapshot fetch has been issued / has failed for a GapDetected result
+    void markResyncRequested() { resyncRequested = true; }
+    void resyncFailed() { resyncRequested = false; }
+
+    // Marks the book stale when the feed connection drops. The snapshot sent on
+    // resubscription rebuilds it; a delta arriving first triggers a REST resync.
+    void invalidate() {
+        resyncing = true;
+        resyncRequested = false;
+        buffered.clear();
+        publish();
+    }
+
+    SyncResult update(const json& data) {
+        SyncResult result = SyncResult::Ignored;
+        if (data.contains("type") && (data["type"] == "change" || data["type"] == "snapshot")) {
+            parse(data, scratch);
+            result = apply(scratch);
+        }
+        return result;
+    }
+
+    const BidLadder& getBids() const { return bids; }
+    const AskLadder& getAsks() const { return asks; }
+
+    // Contiguous views for SIMD processing, levels in worst -> best order (no copies)
+    LevelView bidLevels() const { return bids.view(); }
+    LevelView askLevels() const { return asks.view(); }
+
+};
+
+// Latest-state mailbox between the feed thread and a book's shard.
+// In conflation mode incoming updates are merged into one pending update
+// instead of being queued one by one, so a consumer that falls behind only
+// ever applies the latest book and the backlog cannot grow.
+class ConflationBuffer {
+public:
+    struct Stats {
+        uint64_t received = 0;   // updates pushed by the feed
+        uint64_t coalesced = 0;  // updates merged into one that was still pending
+        uint64_t drained = 0;    // merged updates handed to the book
+    };
+
+private:
+    std::mutex mutex;
+    BookUpdate pending;
+    bool hasPending = false;
+    std::atomic<uint64_t> received{0};
+    std::atomic<uint64_t> coalesced{0};
+    std::atomic<uint64_t> drained{0};
+
+public:
+    // Returns true when nothing was pending, i.e. the caller must schedule a drain
+    bool push(const BookUpdate& u) {
+        received.fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (hasPending) {
+            pending.merge(u);
+            coalesced.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        pending = u;
+        hasPending = true;
+        return true;
+    }
+
+    // Moves the pending update into `out`, recycling out's storage for the next merge
+    bool take(BookUpdate& out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!hasPending) return false;
+        std::swap(out, pending);
+        pending.clear();
+        hasPending = false;
+        drained.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    Stats stats() const {
+        return Stats{received.load(std::memory_order_relaxed),
+                     coalesced.load(std::memory_order_relaxed),
+                     drained.load(std::memory_order_relaxed)};
+    }
+};
+
+// Owns one OrderBook per instrument and pins every instrument to a shard.
+// Books are created when an instrument is subscribed and never removed, so a
+// pointer handed out by find() stays valid for the lifetime of the registry
+// and the shard that owns the instrument can mutate it without locking.
+class OrderBookRegistry {
+public:
+    struct Handle {
+        OrderBook* book = nullptr;
+        size_t shard = 0;
+        ConflationBuffer* conflation = nullptr;
+    };
+
+private:
+    struct Entry {
+        std::unique_ptr<OrderBook> book;
+        std::unique_ptr<ConflationBuffer> conflation;
+        size_t shard;
+    };
+    std::unordered_map<std::string, Entry> books;
+    mutable std::shared_mutex mutex;
+    size_t shardCount;
+
+    static Handle handleOf(const Entry& entry) {
+        return Handle{entry.book.get(), entry.shard, entry.conflation.get()};
+    }
+
+public:
+    explicit OrderBookRegistry(size_t shards) : shardCount(shards == 0 ? 1 : shards) {}
+
+    size_t shardFor(const std::string& instrument) const {
+        return std::hash<std::string>{}(instrument) % shardCount;
+    }
+
+    // Returns the existing book or creates an empty one for the instrument grid
+    Handle getOrCreate(const std::string& instrument, const InstrumentSpec& spec) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        auto it = books.find(instrument);
+        if (it == books.end()) {
+            Entry entry{std::make_unique<OrderBook>(spec), std::make_unique<ConflationBuffer>(), shardFor(instrument)};
+            it = books.emplace(instrument, std::move(entry)).first;
+        }
+        return handleOf(it->second);
+    }
+
+    Handle find(const std::string& instrument) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = books.find(instrument);
+        if (it == books.end()) return Handle{};
+        return handleOf(it->second);
+    }
+
+    std::vector<std::string> instruments() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        std::vector<std::string> names;
+        names.reserve(books.size());
+        for (const auto& entry : books) names.push_back(entry.first);
+        return names;
+    }
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// Last known state of one of the account's orders
+struct OrderState {
+    std::string orderId;
+    std::string instrument;
+    std::string label;
+    std::string direction;    // buy, sell
+    std::string state;        // open, untriggered, filled, cancelled, rejected
+    double price = 0;         // 0 for market orders
+    double amount = 0;
+    double filledAmount = 0;
+    int64_t updatedMs = 0;    // exchange last_update_timestamp
+
+    bool open() const { return state == "open" || state == "untriggered"; }
+
+    static OrderState fromJson(const json& order) {
+        OrderState o;
+        o.orderId = order.value("order_id", std::string());
+        o.instrument = order.value("instrument_name", std::string());
+        if (order.contains("label") && order["label"].is_string()) o.label = order["label"].get<std::string>();
+        o.direction = order.value("direction", std::string());
+        o.state = order.value("order_state", std::string());
+        if (order.contains("price") && order["price"].is_number()) o.price = order["price"].get<double>();
+        o.amount = order.value("amount", 0.0);
+        o.filledAmount = order.value("filled_amount", 0.0);
+        o.updatedMs = order.value("last_update_timestamp", int64_t(0));
+        return o;
+    }
+};
+
+// The account's orders in memory, indexed by order_id and, for open orders, by
+// label and instrument. Fed by the user.orders.* notifications and order
+// acknowledgements, seeded from a private/get_open_orders snapshot. Updates older
+// than what is stored are dropped, so the feed and a snapshot can interleave.
+// Closed orders are kept for their last state, the oldest are evicted past MAX_CLOSED.
+// Reads take a shared lock and copy out; synced() is false until the first
+// snapshot and again after the feed was interrupted.
+class OrderStore {
+    static constexpr size_t MAX_CLOSED = 4096;
+
+    std::unordered_map<std::string, OrderState> orders;
+    std::unordered_map<std::string, std::unordered_set<std::string>> openByLabel;
+    std::unordered_map<std::string, std::unordered_set<std::string>> openByInstrument;
+    std::deque<std::string> closed;   // eviction order
+    mutable std::shared_mutex mutex;
+    std::atomic<bool> isSynced{false};
+
+    static void index(std::unordered_map<std::string, std::unordered_set<std::string>>& by, const std::string& key,
+                      const std::string& orderId, bool add) {
+        if (add) {
+            by[key].insert(orderId);
+            return;
+        }
+        auto it = by.find(key);
+        if (it == by.end()) return;
+        it->second.erase(orderId);
+        if (it->second.empty()) by.erase(it);
+    }
+
+    void reindex(const OrderState& order, bool add) {
+        if (!order.label.empty()) index(openByLabel, order.label, order.orderId, add);
+        index(openByInstrument, order.instrument, order.orderId, add);
+    }
+
+    // Caller holds the unique lock
+    bool store(OrderState order) {
+        if (order.orderId.empty()) return false;
+        auto it = orders.find(order.orderId);
+        if (it != orders.end()) {
+            if (order.updatedMs < it->second.updatedMs) return false;
+            const bool wasOpen = it->second.open();
+            if (wasOpen) reindex(it->second, false);
+            it->second = std::move(order);
+            if (it->second.open()) reindex(it->second, true);
+            else if (wasOpen) retire(it->first);
+            return true;
+        }
+        auto inserted = orders.emplace(order.orderId, std::move(order)).first;
+        if (inserted->second.open()) reindex(inserted->second, true);
+        else retire(inserted->first);
+        return true;
+    }
+
+    void retire(const std::string& orderId) {
+        closed.push_back(orderId);
+        while (closed.size() > MAX_CLOSED) {
+            auto it = orders.find(closed.front());
+            if (it != orders.end() && !it->second.open()) orders.erase(it);
+            closed.pop_front();
+        }
+    }
+
+    std::vector<OrderState> collect(const std::unordered_set<std::string>& ids) const {
+        std::vector<OrderState> out;
+        out.reserve(ids.size());
+        for (const auto& id : ids) out.push_back(orders.at(id));
+        return out;
+    }
+
+public:
+    // One order object, from a notification or an acknowledgement. False when it was stale.
+    bool apply(const json& order) {
+        if (!order.is_object()) return false;
+        OrderState state = OrderState::fromJson(order);
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        return store(std::move(state));
+    }
+
+    // Snapshot of the open orders taken at `snapshotMs` (exchange clock). Orders held
+    // as open that it no longer lists and that have not changed since were closed
+    // while nobody was listening.
+    void seed(const json& openOrders, int64_t snapshotMs) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        std::unordered_set<std::string> listed;
+        for (const auto& order : openOrders) {
+            if (!order.is_object()) continue;
+            OrderState state = OrderState::fromJson(order);
+            listed.insert(state.orderId);
+            store(std::move(state));
+        }
+        std::vector<std::string> gone;
+        for (const auto& entry : orders) {
+            if (entry.second.open() && entry.second.updatedMs <= snapshotMs && !listed.count(entry.first))
+                gone.push_back(entry.first);
+        }
+        for (const auto& id : gone) {
+            OrderState state = orders.at(id);
+            state.state = "closed";
+            store(std::move(state));
+        }
+        isSynced.store(true);
+    }
+
+    // The feed dropped, local answers may be stale until the next seed
+    void invalidate() { isSynced.store(false); }
+    bool synced() const { return isSynced.load(); }
+
+    bool find(const std::string& orderId, OrderState& out) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = orders.find(orderId);
+        if (it == orders.end()) return false;
+        out = it->second;
+        return true;
+    }
+
+    std::vector<OrderState> openOrders() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        std::vector<OrderState> out;
+        for (const auto& entry : openByInstrument) {
+            for (const auto& id : entry.second) out.push_back(orders.at(id));
+        }
+        return out;
+    }
+
+    std::vector<OrderState> openOrders(const std::string& instrument) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = openByInstrument.find(instrument);
+        return it == openByInstrument.end() ? std::vector<OrderState>() : collect(it->second);
+    }
+
+    std::vector<OrderState> openOrdersByLabel(const std::string& label) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = openByLabel.find(label);
+        return it == openByLabel.end() ? std::vector<OrderState>() : collect(it->second);
+    }
+
+    size_t openCount() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        size_t count = 0;
+        for (const auto& entry : openByInstrument) count += entry.second.size();
+        return count;
+    }
+};
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "fixed_point.hpp"
+
+// Appends the decimal digits of `v`, no locale, no allocation once `out` has capacity
+inline void appendInt(std::string& out, int64_t v) {
+    char digits[20];
+    char* p = digits + sizeof(digits);
+    uint64_t u = v < 0 ? 0 - static_cast<uint64_t>(v) : static_cast<uint64_t>(v);
+    do {
+        *--p = static_cast<char>('0' + u % 10);
+        u /= 10;
+    } while (u);
+    if (v < 0) out.push_back('-');
+    out.append(p, static_cast<size_t>(digits + sizeof(digits) - p));
+}
+
+// Appends `steps` of `step` as an exact decimal, trailing zeros trimmed:
+// 126001 ticks of 0.5 -> 63000.5, 30 lots of 10 -> 300
+inline void appendDecimal(std::string& out, int64_t steps, const DecimalStep& step) {
+    int64_t scaled = steps * step.units;
+    if (step.decimals == 0) {
+        appendInt(out, scaled);
+        return;
+    }
+    const int64_t divisor = DecimalStep::pow10(step.decimals);
+    if (scaled < 0) {
+        out.push_back('-');
+        scaled = -scaled;
+    }
+    appendInt(out, scaled / divisor);
+    int64_t fraction = scaled % divisor;
+    if (fraction == 0) return;
+    int width = step.decimals;
+    while (fraction % 10 == 0) {
+        fraction /= 10;
+        --width;
+    }
+    char digits[20];
+    for (int i = width - 1; i >= 0; --i) {
+        digits[i] = static_cast<char>('0' + fraction % 10);
+        fraction /= 10;
+    }
+    out.push_back('.');
+    out.append(digits, static_cast<size_t>(width));
+}
+
+// Appends `s` as the inside of a JSON string
+inline void appendEscaped(std::string& out, const std::string& s) {
+    static const char hex[] = "0123456789abcdef";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out.append("\\u00");
+            out.push_back(hex[(c >> 4) & 0xf]);
+            out.push_back(hex[c & 0xf]);
+        } else {
+            out.push_back(c);
+        }
+    }
+}
+
+// One order-entry request, kept as its slots rather than as a json tree.
+// write() lays it out in the fixed byte order of its method's template
+//   {"jsonrpc":"2.0","id":<id>,"method":"private/buy","params":{"instrument_name":"<instrument>","type":"limit","price":<price>,"amount":<amount>[,"label":"<label>"]}}
+// straight into a caller-owned buffer that keeps its capacity, so repeated
+// orders serialize without allocating. Prices and amounts stay integer
+// ticks and lots until they are printed as exact decimals.
+struct OrderRequest {
+    enum class Kind : uint8_t { Buy, Sell, Edit, Cancel, CancelAllByInstrument, CancelByLabel };
+
+    Kind kind = Kind::Buy;
+    std::string instrument;   // buy, sell, cancel all by instrument
+    std::string orderId;      // edit, cancel
+    std::string label;        // optional for buy and sell, cancel by label
+    Price price;
+    Quantity amount;
+    DecimalStep tick;
+    DecimalStep lot;
+
+    static OrderRequest buy(const InstrumentSpec& spec, Price price, Quantity amount, const std::string& label = std::string()) {
+        OrderRequest r;
+        r.kind = Kind::Buy;
+        r.instrument = spec.name;
+        r.label = label;
+        r.price = price;
+        r.amount = amount;
+        r.tick = spec.tick;
+        r.lot = spec.lot;
+        return r;
+    }
+
+    static OrderRequest sell(const InstrumentSpec& spec, Price price, Quantity amount, const std::string& label = std::string()) {
+        OrderRequest r = buy(spec, price, amount, label);
+        r.kind = Kind::Sell;
+        return r;
+    }
+
+    static OrderRequest edit(const std::string& orderId, const InstrumentSpec& spec, Price price, Quantity amount) {
+        OrderRequest r;
+        r.kind = Kind::Edit;
+        r.orderId = orderId;
+        r.price = price;
+        r.amount = amount;
+        r.tick = spec.tick;
+        r.lot = spec.lot;
+        return r;
+    }
+
+    static OrderRequest cancel(const std::string& orderId) {
+        OrderRequest r;
+        r.kind = Kind::Cancel;
+        r.orderId = orderId;
+        return r;
+    }
+
+    // One request for every open order of the instrument
+    static OrderRequest cancelAll(const std::string& instrument) {
+        OrderRequest r;
+        r.kind = Kind::CancelAllByInstrument;
+        r.instrument = instrument;
+        return r;
+    }
+
+    // One request for every open order carrying the label, on any instrument
+    static OrderRequest cancelByLabel(const std::string& label) {
+        OrderRequest r;
+        r.kind = Kind::CancelByLabel;
+        r.label = label;
+        return r;
+    }
+
+    const char* method() const {
+        switch (kind) {
+            case Kind::Buy: return "private/buy";
+            case Kind::Sell: return "private/sell";
+            case Kind::Edit: return "private/edit";
+            case Kind::Cancel: return "private/cancel";
+            case Kind::CancelAllByInstrument: return "private/cancel_all_by_instrument";
+            case Kind::CancelByLabel: return "private/cancel_by_label";
+        }
+        return "";
+    }
+
+    // Replaces the contents of `out` with the request under `id`
+    void write(std::string& out, int64_t id) const {
+        out.clear();
+        out.append("{\"jsonrpc\":\"2.0\",\"id\":");
+        appendInt(out, id);
+        switch (kind) {
+            case Kind::Buy:
+            case Kind::Sell:
+                out.append(kind == Kind::Buy ? ",\"method\":\"private/buy\",\"params\":{\"instrument_name\":\""
+                                             : ",\"method\":\"private/sell\",\"params\":{\"instrument_name\":\"");
+                appendEscaped(out, instrument);
+                out.append("\",\"type\":\"limit\",\"price\":");
+                appendDecimal(out, price.ticks, tick);
+                out.append(",\"amount\":");
+                appendDecimal(out, amount.lots, lot);
+                if (!label.empty()) {
+                    out.append(",\"label\":\"");
+                    appendEscaped(out, label);
+                    out.push_back('"');
+                }
+                break;
+            case Kind::Edit:
+                out.append(",\"method\":\"private/edit\",\"params\":{\"order_id\":\"");
+                appendEscaped(out, orderId);
+                out.append("\",\"price\":");
+                appendDecimal(out, price.ticks, tick);
+                out.append(",\"amount\":");
+                appendDecimal(out, amount.lots, lot);
+                break;
+            case Kind::Cancel:
+                out.append(",\"method\":\"private/cancel\",\"params\":{\"order_id\":\"");
+                appendEscaped(out, orderId);
+                out.push_back('"');
+                break;
+            case Kind::CancelAllByInstrument:
+                out.append(",\"method\":\"private/cancel_all_by_instrument\",\"params\":{\"instrument_name\":\"");
+                appendEscaped(out, instrument);
+                out.push_back('"');
+                break;
+            case Kind::CancelByLabel:
+                out.append(",\"method\":\"private/cancel_by_label\",\"params\":{\"label\":\"");
+                appendEscaped(out, label);
+                out.push_back('"');
+                break;
+        }
+        out.append("}}");
+    }
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <nlohmann/json.hpp>
+#include "json_cursor.hpp"
+
+using json = nlohmann::json;
+
+// JSON-RPC response decoded lazily.
+// decode() walks the body once and keeps only what the order paths look at:
+// the error code and text, the span of `result` and, for order
+// acknowledgements, the order's id, state, instrument, label and filled
+// amount. Buy, sell and edit answer {"order":{...},"trades":[...]}, cancel
+// answers the order itself; trades and every other member are skipped without
+// being built. The views point into the body, which must outlive the decoder.
+// Bodies the scanner does not handle (escaped strings) are parsed with
+// nlohmann::json instead and the views then point into that document.
+// The full DOM is only built when document() or resultJson() is called.
+class RpcResponse {
+public:
+    int64_t id = 0;
+    bool hasResult = false;
+    bool hasError = false;
+    int64_t errorCode = 0;
+    std::string_view errorMessage;
+    std::string_view errorReason;   // error.data.reason
+    std::string_view message;       // top-level "message" of non JSON-RPC errors
+
+    // Order acknowledgement, empty when the result is not an order
+    std::string_view orderId;
+    std::string_view orderState;
+    std::string_view instrument;
+    std::string_view label;
+    double filledAmount = 0;
+    size_t trades = 0;
+
+    RpcResponse() = default;
+    RpcResponse(const RpcResponse&) = delete;  // the views may point into `parsed`
+    RpcResponse& operator=(const RpcResponse&) = delete;
+    RpcResponse(RpcResponse&&) = default;
+    RpcResponse& operator=(RpcResponse&&) = default;
+
+    // False when the body is not a JSON object at all
+    bool decode(std::string_view response) {
+        *this = RpcResponse();
+        body = response;
+        JsonCursor c{response.data(), response.data() + response.size()};
+        bool ok = c.object([&](std::string_view key) {
+            if (key == "id") return c.integer(id) || c.skipValue();
+            if (key == "result") return parseResult(c);
+            if (key == "error") return parseError(c);
+            if (key == "message") return stringField(c, message);
+            return c.skipValue();
+        });
+        if (ok) return true;
+        return decodeDocument();
+    }
+
+    // Only the top-level id, the scan stops as soon as it is read. False when the
+    // body has none the scanner can read (notifications, escaped keys).
+    static bool readId(std::string_view response, int64_t& out) {
+        JsonCursor c{response.data(), response.data() + response.size()};
+        bool found = false;
+        c.object([&](std::string_view key) {
+            if (key != "id") return c.skipValue();
+            found = c.integer(out);
+            return false;
+        });
+        return found;
+    }
+
+    bool ok() const { return hasResult && !hasError; }
+
+    // Error text as the order paths print it, empty when the request succeeded
+    std::string errorText() const {
+        if (hasError) {
+            if (!errorReason.empty()) return quoted(errorReason);
+            if (!errorMessage.empty()) return quoted(errorMessage);
+            return parsed.is_null() ? std::string(error) : parsed["error"].dump();
+        }
+        if (!message.empty()) return quoted(message);
+        return std::string();
+    }
+
+    // Full parse, only for callers that need more than the decoded fields
+    json document() const {
+        return parsed.is_null() ? json::parse(body) : parsed;
+    }
+
+    // Only the result member, parsed on demand
+    json resultJson() const {
+        if (!parsed.is_null()) return parsed.value("result", json());
+        return result.empty() ? json() : json::parse(result);
+    }
+
+private:
+    std::string_view body;
+    std::string_view error;    // raw text of the error member
+    std::string_view result;   // raw text of the result member
+    json parsed;               // only set by the fallback
+
+    static std::string quoted(std::string_view s) {
+        return "\"" + std::string(s) + "\"";
+    }
+
+    // String member; other types (null labels) are skipped and leave `out` empty
+    static bool stringField(JsonCursor& c, std::string_view& out) {
+        return c.peek('"') ? c.string(out) : c.skipValue();
+    }
+
+    bool orderField(JsonCursor& c, std::string_view key) {
+        if (key == "order_id") return stringField(c, orderId);
+        if (key == "order_state") return stringField(c, orderState);
+        if (key == "instrument_name") return stringField(c, instrument);
+        if (key == "label") return stringField(c, label);
+        if (key == "filled_amount") return c.real(filledAmount) || c.skipValue();
+        return c.skipValue();
+    }
+
+    bool parseResult(JsonCursor& c) {
+        hasResult = true;
+        c.skipSpace();
+        const char* start = c.p;
+        bool ok;
+        if (c.peek('{')) {
+            ok = c.object([&](std::string_view key) {
+                if (key == "order") return c.object([&](std::string_view field) { return orderField(c, field); });
+                if (key == "trades") return c.peek('[') ? c.array([&] { ++trades; return c.skipValue(); }) : c.skipValue();
+                return orderField(c, key);
+            });
+        } else {
+            ok = c.skipValue();
+        }
+        result = std::string_view(start, static_cast<size_t>(c.p - start));
+        return ok;
+    }
+
+    bool parseError(JsonCursor& c) {
+        hasError = true;
+        c.skipSpace();
+        const char* start = c.p;
+        bool ok = c.object([&](std::string_view key) {
+            if (key == "code") return c.integer(errorCode) || c.skipValue();
+            if (key == "message") return stringField(c, errorMessage);
+            if (key == "data") {
+                if (!c.peek('{')) return c.skipValue();
+                return c.object([&](std::string_view field) {
+                    return field == "reason" ? stringField(c, errorReason) : c.skipValue();
+                });
+            }
+            return c.skipValue();
+        });
+        error = std::string_view(start, static_cast<size_t>(c.p - start));
+        return ok;
+    }
+
+    static std::string_view view(const json& object, const char* key) {
+        if (!object.is_object() || !object.contains(key) || !object[key].is_string()) return std::string_view();
+        return object[key].get_ref<const std::string&>();
+    }
+
+    bool decodeDocument() {
+        std::string_view response = body;
+        *this = RpcResponse();
+        body = response;
+        try {
+            parsed = json::parse(body);
+        } catch (const json::parse_error&) {
+            return false;
+        }
+        if (!parsed.is_object()) return false;
+        if (parsed.contains("id") && parsed["id"].is_number_integer()) id = parsed["id"].get<int64_t>();
+        message = view(parsed, "message");
+        if (parsed.contains("error")) {
+            const json& e = parsed["error"];
+            hasError = true;
+            errorCode = e.is_object() ? e.value("code", int64_t(0)) : 0;
+            errorMessage = view(e, "message");
+            if (e.is_object() && e.contains("data")) errorReason = view(e["data"], "reason");
+        }
+        if (parsed.contains("result")) {
+            const json& r = parsed["result"];
+            hasResult = true;
+            const json& order = r.is_object() && r.contains("order") ? r["order"] : r;
+            orderId = view(order, "order_id");
+            orderState = view(order, "order_state");
+            instrument = view(order, "instrument_name");
+            label = view(order, "label");
+            if (order.is_object() && order.contains("filled_amount") && order["filled_amount"].is_number()) {
+                filledAmount = order["filled_amount"].get<double>();
+            }
+            if (r.is_object() && r.contains("trades") && r["trades"].is_array()) trades = r["trades"].size();
+        }
+        return true;
+    }
+};
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// Receives the full JSON-RPC response of an asynchronous request
+using RpcCallback = std::function<void(const json&)>;
+
+// Receives the response text as it arrived, for callers that decode it themselves (RpcResponse)
+using RpcTextCallback = std::function<void(const std::string&)>;
+
+// Error response in the exchange's JSON-RPC shape, for failures that never reached it
+inline json rpcError(const std::string& message) {
+    return {{"jsonrpc", "2.0"}, {"error", {{"code", -1}, {"message", message}}}};
+}
+
+// Table of in-flight JSON-RPC requests.
+// Every request gets a unique id and its callback waits here until the
+// response carrying that id is handed to complete(), or until its deadline
+// passes and a timeout error is delivered instead; whichever comes first
+// wins and the other is ignored. Callbacks run without the lock held, on the
+// thread that completed the request or on the tracker's timeout thread, and
+// must not block.
+class RpcTracker {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats {
+        uint64_t sent = 0;
+        uint64_t completed = 0;
+        uint64_t failed = 0;    // transport errors, dropped connections
+        uint64_t timedOut = 0;
+        size_t inFlight = 0;
+    };
+
+private:
+    // One of the two callbacks is set
+    struct Waiter {
+        RpcCallback callback;
+        RpcTextCallback text;
+
+        explicit operator bool() const { return callback || text; }
+
+        void deliver(const json& response) const {
+            if (text) text(response.dump());
+            else callback(response);
+        }
+    };
+
+    struct Entry {
+        Waiter waiter;
+        std::function<void()> cancel;   // aborts the transport's work on timeout
+        int channel;
+        std::multimap<Clock::time_point, int64_t>::iterator deadline;
+    };
+
+    std::atomic<int64_t> lastId;
+    std::unordered_map<int64_t, Entry> inFlight;
+    std::multimap<Clock::time_point, int64_t> deadlines;  // earliest first
+    mutable std::mutex mutex;
+    std::condition_variable deadlineChanged;
+    bool stop = false;
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> failed{0};
+    std::atomic<uint64_t> timedOut{0};
+    std::thread timeoutThread;
+
+    // Removes the entry under the lock and returns its waiter, empty if already gone
+    Waiter take(int64_t id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = inFlight.find(id);
+        if (it == inFlight.end()) return Waiter();
+        Waiter waiter = std::move(it->second.waiter);
+        deadlines.erase(it->second.deadline);
+        inFlight.erase(it);
+        return waiter;
+    }
+
+    int64_t add(Waiter waiter, std::chrono::milliseconds timeout, int channel) {
+        const int64_t id = nextId();
+        bool earliest;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto deadline = deadlines.emplace(Clock::now() + timeout, id);
+            earliest = deadline == deadlines.begin();
+            inFlight.emplace(id, Entry{std::move(waiter), std::function<void()>(), channel, deadline});
+        }
+        ++sent;
+        if (earliest) deadlineChanged.notify_one();
+        return id;
+    }
+
+    void expireLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stop) {
+            if (deadlines.empty()) {
+                deadlineChanged.wait(lock);
+                continue;
+            }
+            Clock::time_point next = deadlines.begin()->first;
+            if (Clock::now() < next) {
+                deadlineChanged.wait_until(lock, next);
+                continue;
+            }
+            std::vector<Waiter> expired;
+            std::vector<std::function<void()>> cancels;
+            Clock::time_point now = Clock::now();
+            while (!deadlines.empty() && deadlines.begin()->first <= now) {
+                auto it = inFlight.find(deadlines.begin()->second);
+                expired.push_back(std::move(it->second.waiter));
+                if (it->second.cancel) cancels.push_back(std::move(it->second.cancel));
+                inFlight.erase(it);
+                deadlines.erase(deadlines.begin());
+            }
+            lock.unlock();
+            timedOut += expired.size();
+            for (auto& cancel : cancels) cancel();
+            for (auto& waiter : expired) waiter.deliver(rpcError("Request timed out"));
+            lock.lock();
+        }
+    }
+
+public:
+    // Ids start above `firstId` so they never collide with fixed ids still in use
+    explicit RpcTracker(int64_t firstId = 100) : lastId(firstId), timeoutThread([this] { expireLoop(); }) {}
+
+    ~RpcTracker() { stopTimeouts(); }
+
+    // Joins the timeout thread, for owners whose timeout actions use members destroyed
+    // before the tracker. Requests in flight can still be completed or failed.
+    void stopTimeouts() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        deadlineChanged.notify_all();
+        if (timeoutThread.joinable()) timeoutThread.join();
+    }
+
+    // Fresh id for a request that is not tracked (blocking calls)
+    int64_t nextId() { return ++lastId; }
+
+    // Registers a request and returns the id to send it under. `channel` groups
+    // requests that share a connection, so they can be failed together.
+    int64_t track(RpcCallback callback, std::chrono::milliseconds timeout, int channel = 0) {
+        return add(Waiter{std::move(callback), RpcTextCallback()}, timeout, channel);
+    }
+
+    // Same, but the callback gets the response text; errors arrive as rpcError() text
+    int64_t trackText(RpcTextCallback callback, std::chrono::milliseconds timeout, int channel = 0) {
+        return add(Waiter{RpcCallback(), std::move(callback)}, timeout, channel);
+    }
+
+    // Adds `cancel` to what runs if the request times out, e.g. aborting its transfer.
+    // False if it is no longer in flight; the caller then cancels at once if needed.
+    bool onTimeout(int64_t id, std::function<void()> cancel) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = inFlight.find(id);
+        if (it == inFlight.end()) return false;
+        std::function<void()>& current = it->second.cancel;
+        if (current) {
+            current = [first = std::move(current), then = std::move(cancel)] { first(); then(); };
+        } else {
+            current = std::move(cancel);
+        }
+        return true;
+    }
+
+    // False once the request was answered, failed or timed out
+    bool pending(int64_t id) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return inFlight.count(id) != 0;
+    }
+
+    // Delivers the response to the request with that id, false if it is not (or no longer) in flight
+    bool complete(int64_t id, const json& response) {
+        Waiter waiter = take(id);
+        if (!waiter) return false;
+        ++completed;
+        waiter.deliver(response);
+        return true;
+    }
+
+    // Response text as received. Only requests tracked with a json callback pay for
+    // the parse; an unreadable text fails them instead.
+    bool completeText(int64_t id, const std::string& text) {
+        Waiter waiter = take(id);
+        if (!waiter) return false;
+        if (waiter.text) {
+            ++completed;
+            waiter.text(text);
+            return true;
+        }
+        json response;
+        try {
+            response = json::parse(text);
+        } catch (const std::exception& e) {
+            ++failed;
+            waiter.callback(rpcError(e.what()));
+            return true;
+        }
+        ++completed;
+        waiter.callback(response);
+        return true;
+    }
+
+    bool fail(int64_t id, const std::string& reason) {
+        Waiter waiter = take(id);
+        if (!waiter) return false;
+        ++failed;
+        waiter.deliver(rpcError(reason));
+        return true;
+    }
+
+    // Fails every request of a channel, e.g. when its connection drops
+    void failAll(int channel, const std::string& reason) {
+        std::vector<Waiter> dropped;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto it = inFlight.begin(); it != inFlight.end();) {
+                if (it->second.channel != channel) {
+                    ++it;
+                    continue;
+                }
+                dropped.push_back(std::move(it->second.waiter));
+                deadlines.erase(it->second.deadline);
+                it = inFlight.erase(it);
+            }
+        }
+        failed += dropped.size();
+        for (auto& waiter : dropped) waiter.deliver(rpcError(reason));
+    }
+
+    Stats stats() const {
+        Stats s;
+        s.sent = sent.load();
+        s.completed = completed.load();
+        s.failed = failed.load();
+        s.timedOut = timedOut.load();
+        std::lock_guard<std::mutex> lock(mutex);
+        s.inFlight = inFlight.size();
+        return s;
+    }
+};
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// OAuth tokens of one session, as returned by public/auth
+struct AuthTokens {
+    std::string accessToken;
+    std::string refreshToken;
+    int64_t expiresAtMs = 0;   // system clock, ms since epoch
+
+    static int64_t nowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    static AuthTokens fromResult(const json& result) {
+        AuthTokens t;
+        t.accessToken = result.value("access_token", std::string());
+        t.refreshToken = result.value("refresh_token", std::string());
+        t.expiresAtMs = nowMs() + result.value("expires_in", int64_t(0)) * 1000;
+        return t;
+    }
+
+    bool empty() const { return accessToken.empty(); }
+
+    // Usable for at least `margin` more
+    bool validFor(std::chrono::milliseconds margin) const {
+        return !empty() && expiresAtMs - nowMs() > margin.count();
+    }
+
+    // When to refresh: a tenth of the lifetime before expiry, at least 30 s and at most
+    // 5 min before, but never sooner than a second after issue
+    int64_t refreshAtMs(int64_t issuedAtMs) const {
+        int64_t lifetime = std::max<int64_t>(0, expiresAtMs - issuedAtMs);
+        int64_t lead = std::min<int64_t>(300000, std::max<int64_t>(30000, lifetime / 10));
+        return std::max(expiresAtMs - lead, issuedAtMs + 1000);
+    }
+};
+
+// Token cache on disk, encrypted with AES-256-GCM under a key derived from
+// the client secret, so only a process holding the API credentials can read
+// it back. Layout: magic, PBKDF2 salt, GCM nonce, ciphertext, tag. The client
+// id is authenticated data, a file written for another key is rejected.
+// Written with mode 0600 to a temporary file and renamed into place.
+class TokenCache {
+    static constexpr char MAGIC[8] = {'D', 'R', 'B', 'T', 'K', 'N', '0', '1'};
+    static constexpr size_t SALT = 16;
+    static constexpr size_t NONCE = 12;
+    static constexpr size_t TAG = 16;
+    static constexpr int ITERATIONS = 10000;  // the secret is already random, this only stretches it
+
+    const std::string path;
+    const std::string clientId;
+    const std::string secret;
+
+    bool deriveKey(const unsigned char* salt, unsigned char* key) const {
+        return PKCS5_PBKDF2_HMAC(secret.data(), static_cast<int>(secret.size()), salt, SALT, ITERATIONS,
+                                 EVP_sha256(), 32, key) == 1;
+    }
+
+    // One GCM pass; on decrypt `tag` is checked, on encrypt it is written
+    bool crypt(bool encrypt, const unsigned char* key, const unsigned char* nonce, const std::string& in,
+               std::string& out, unsigned char* tag) const {
+        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+        if (!ctx) return false;
+        int len = 0;
+        int aadLen = 0;
+        out.resize(in.size());
+        auto init = encrypt ? EVP_EncryptInit_ex : EVP_DecryptInit_ex;
+        auto update = encrypt ? EVP_EncryptUpdate : EVP_DecryptUpdate;
+        bool ok = init(ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr) == 1 &&
+                  EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, NONCE, nullptr) == 1 &&
+                  init(ctx, nullptr, nullptr, key, nonce) == 1 &&
+                  update(ctx, nullptr, &aadLen, reinterpret_cast<const unsigned char*>(clientId.data()), static_cast<int>(clientId.size())) == 1 &&
+                  update(ctx, reinterpret_cast<unsigned char*>(&out[0]), &len, reinterpret_cast<const unsigned char*>(in.data()), static_cast<int>(in.size())) == 1;
+        if (ok && encrypt) {
+            ok = EVP_EncryptFinal_ex(ctx, nullptr, &aadLen) == 1 && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, TAG, tag) == 1;
+        } else if (ok) {
+            unsigned char final[16];
+            ok = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, TAG, tag) == 1 && EVP_DecryptFinal_ex(ctx, final, &aadLen) == 1;
+        }
+        EVP_CIPHER_CTX_free(ctx);
+        return ok;
+    }
+
+public:
+    TokenCache(std::string file, std::string id, std::string clientSecret)
+        : path(std::move(file)), clientId(std::move(id)), secret(std::move(clientSecret)) {}
+
+    const std::string& file() const { return path; }
+
+    // False when there is no cache, it was written for other credentials, or it was tampered with
+    bool load(AuthTokens& tokens) const {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return false;
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        const size_t header = sizeof(MAGIC) + SALT + NONCE;
+        if (data.size() < header + TAG || data.compare(0, sizeof(MAGIC), MAGIC, sizeof(MAGIC)) != 0) return false;
+
+        auto bytes = reinterpret_cast<const unsigned char*>(data.data());
+        unsigned char key[32];
+        unsigned char tag[TAG];
+        std::copy(bytes + data.size() - TAG, bytes + data.size(), tag);
+        if (!deriveKey(bytes + sizeof(MAGIC), key)) return false;
+        std::string plain;
+        bool ok = crypt(false, key, bytes + sizeof(MAGIC) + SALT, data.substr(header, data.size() - header - TAG), plain, tag);
+        OPENSSL_cleanse(key, sizeof(key));
+        if (!ok) return false;
+        try {
+            json j = json::parse(plain);
+            tokens.accessToken = j.at("access_token").get<std::string>();
+            tokens.refreshToken = j.at("refresh_token").get<std::string>();
+            tokens.expiresAtMs = j.at("expires_at_ms").get<int64_t>();
+        } catch (const json::exception&) {
+            return false;
+        }
+        return true;
+    }
+
+    bool save(const AuthTokens& tokens) const {
+        unsigned char salt[SALT];
+        unsigned char nonce[NONCE];
+        unsigned char key[32];
+        unsigned char tag[TAG];
+        if (RAND_bytes(salt, SALT) != 1 || RAND_bytes(nonce, NONCE) != 1 || !deriveKey(salt, key)) return false;
+        json j = {{"access_token", tokens.accessToken}, {"refresh_token", tokens.refreshToken}, {"expires_at_ms", tokens.expiresAtMs}};
+        std::string cipher;
+        bool ok = crypt(true, key, nonce, j.dump(), cipher, tag);
+        OPENSSL_cleanse(key, sizeof(key));
+        if (!ok) return false;
+
+        std::string data(MAGIC, sizeof(MAGIC));
+        data.append(reinterpret_cast<const char*>(salt), SALT);
+        data.append(reinterpret_cast<const char*>(nonce), NONCE);
+        data += cipher;
+        data.append(reinterpret_cast<const char*>(tag), TAG);
+
+        const std::string temp = path + ".tmp";
+        int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (fd < 0) return false;
+        ssize_t written = ::write(fd, data.data(), data.size());
+        ok = written == static_cast<ssize_t>(data.size()) && ::fsync(fd) == 0;
+        ok = ::close(fd) == 0 && ok;
+        if (!ok || std::rename(temp.c_str(), path.c_str()) != 0) {
+            ::unlink(temp.c_str());
+            return false;
+        }
+        return true;
+    }
+};